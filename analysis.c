@@ -0,0 +1,934 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "analysis.h"
+#include "constant.h"
+
+/* How an instruction passes control on. */
+enum flow {
+    FLOW_NEXT,      /* On to the following instruction. */
+    FLOW_JUMP,      /* To a fixed address. */
+    FLOW_CALL,      /* To a fixed address, returning to the following one. */
+    FLOW_RETURN,    /* To the address on top of the stack. */
+    FLOW_SKIP,      /* On to one of the two following instructions. */
+    FLOW_DYNAMIC,   /* To an address computed from a register. */
+    FLOW_HALT,      /* Nowhere; the application exits. */
+    FLOW_INVALID    /* Nowhere; the opcode cannot be decoded. */
+};
+
+/* How an instruction changes I. */
+enum i_effect {I_KEEP, I_SET, I_ADD_REGISTER};
+
+/* The parts of a decoded instruction that matter to the analysis. */
+struct instruction {
+    enum Analysis_op op;
+    uint16_t size;
+    enum flow flow;
+    uint16_t target;
+    enum i_effect i_effect;
+    /* Lowest and highest value that I_SET may set I to. */
+    uint16_t i_low, i_high;
+    /* Number of bytes read from and written to memory starting at I. */
+    uint16_t read_count, write_count;
+};
+
+/* An inclusive range of values that a quantity may take. */
+struct range {
+    int32_t low, high;
+};
+
+/* What is known about the CPU whenever execution enters a block. */
+struct state {
+    enum bool reached;
+    struct range i;
+    struct range depth;
+    /* Times the state has grown, so that I can be widened in loops. */
+    uint8_t update_count;
+};
+
+/* After this many updates of a block's entry state, a growing range for I is
+ * widened to every possible value so that the analysis terminates quickly. */
+static const uint8_t WIDEN_AFTER = 8;
+
+/* The largest value of the 16-bit I register. */
+static const int32_t I_MAX = 0xFFFF;
+
+/* Instructions per frame for each mode, as a multiple of CYCLES_PER_DELAY.
+ * Applications written for the later interpreters expect faster machines.
+ * The speed an application was tuned for is a property of the interpreter
+ * it was written against, which nothing in its code reveals, so this is
+ * per mode rather than per application; it is still kept with the rest of
+ * the analysis so that the cache can hold a per-application value. */
+static const uint16_t CYCLES_PER_FRAME_SCALE[] = {1, 3, 20};
+
+/* -------------------------------------------------------------------------- */
+/* Private Interface -------------------------------------------------------- */
+
+/* Return TRUE iff. the CPU invariants allow execution at `address`. */
+static enum bool is_valid_target(uint32_t address, uint32_t memory_size)
+{
+    return address >= APPLICATION_START && address % 2 == 0
+           && address + 1 < memory_size ? TRUE : FALSE;
+}
+
+/* Return the size in bytes of the instruction at `address`, as the CPU
+ * computes it when skipping over it. */
+static uint16_t size_at(const uint8_t *memory, uint32_t memory_size,
+                        enum Chip8_mode mode, uint32_t address)
+{
+    if (mode == MODE_XOCHIP && address + 1 < memory_size
+        && memory[address] == 0xF0 && memory[address + 1] == 0x00) {
+        return 4;
+    }
+    return 2;
+}
+
+/* Decode the instruction at `address` the same way Cpu_cycle does. */
+static void decode(const uint8_t *memory, uint32_t memory_size,
+                   enum Chip8_mode mode, uint32_t address,
+                   struct instruction *instruction)
+{
+    uint16_t opcode;
+    uint8_t x, y, n, nn;
+
+    memset(instruction, 0, sizeof *instruction);
+    instruction->size = 2;
+    instruction->flow = FLOW_NEXT;
+    instruction->i_effect = I_KEEP;
+
+    if (address + 1 >= memory_size) {
+        instruction->flow = FLOW_INVALID;
+        return;
+    }
+
+    opcode = memory[address] << 8u | memory[address + 1];
+    x = (opcode >> 8) & 0x0F;
+    y = (opcode >> 4) & 0x0F;
+    n = opcode & 0x0F;
+    nn = opcode & 0xFF;
+    instruction->target = opcode & 0x0FFF;
+
+    switch (opcode >> 12) {
+        case 0x0:
+            if (opcode == 0x00E0) {
+                instruction->op = OP_CLEAR;
+            }
+            else if (opcode == 0x00EE) {
+                instruction->op = OP_RETURN;
+                instruction->flow = FLOW_RETURN;
+            }
+            else if ((opcode & 0xFFF0) == 0x00C0 && mode >= MODE_SCHIP) {
+                instruction->op = OP_SCROLL_DOWN;
+            }
+            else if ((opcode & 0xFFF0) == 0x00D0 && mode == MODE_XOCHIP) {
+                instruction->op = OP_SCROLL_UP;
+            }
+            else if (opcode == 0x00FB && mode >= MODE_SCHIP) {
+                instruction->op = OP_SCROLL_RIGHT;
+            }
+            else if (opcode == 0x00FC && mode >= MODE_SCHIP) {
+                instruction->op = OP_SCROLL_LEFT;
+            }
+            else if (opcode == 0x00FD && mode >= MODE_SCHIP) {
+                instruction->op = OP_EXIT;
+                instruction->flow = FLOW_HALT;
+            }
+            else if (opcode == 0x00FE && mode >= MODE_SCHIP) {
+                instruction->op = OP_LORES;
+            }
+            else if (opcode == 0x00FF && mode >= MODE_SCHIP) {
+                instruction->op = OP_HIRES;
+            }
+            else {
+                instruction->flow = FLOW_INVALID;
+            }
+            break;
+
+        case 0x1:
+            instruction->op = OP_JUMP;
+            instruction->flow = FLOW_JUMP;
+            break;
+
+        case 0x2:
+            instruction->op = OP_CALL;
+            instruction->flow = FLOW_CALL;
+            break;
+
+        case 0x3:
+            instruction->op = OP_SKIP_EQUAL_IMMEDIATE;
+            instruction->flow = FLOW_SKIP;
+            break;
+
+        case 0x4:
+            instruction->op = OP_SKIP_NOT_EQUAL_IMMEDIATE;
+            instruction->flow = FLOW_SKIP;
+            break;
+
+        case 0x5:
+            if (n == 0) {
+                instruction->op = OP_SKIP_EQUAL;
+                instruction->flow = FLOW_SKIP;
+            }
+            else if (n == 2 && mode == MODE_XOCHIP) {
+                instruction->op = OP_SAVE_RANGE;
+                instruction->write_count = (x > y ? x - y : y - x) + 1;
+            }
+            else if (n == 3 && mode == MODE_XOCHIP) {
+                instruction->op = OP_LOAD_RANGE;
+                instruction->read_count = (x > y ? x - y : y - x) + 1;
+            }
+            else {
+                instruction->flow = FLOW_INVALID;
+            }
+            break;
+
+        case 0x6:
+            instruction->op = OP_SET_IMMEDIATE;
+            break;
+
+        case 0x7:
+            instruction->op = OP_ADD_IMMEDIATE;
+            break;
+
+        case 0x8:
+            if (n <= 0x7) {
+                instruction->op = OP_SET + n;
+            }
+            else if (n == 0xE) {
+                instruction->op = OP_SHIFT_LEFT;
+            }
+            else {
+                instruction->flow = FLOW_INVALID;
+            }
+            break;
+
+        case 0x9:
+            if (n == 0) {
+                instruction->op = OP_SKIP_NOT_EQUAL;
+                instruction->flow = FLOW_SKIP;
+            }
+            else {
+                instruction->flow = FLOW_INVALID;
+            }
+            break;
+
+        case 0xA:
+            instruction->op = OP_SET_I;
+            instruction->i_effect = I_SET;
+            instruction->i_low = instruction->i_high = opcode & 0x0FFF;
+            break;
+
+        case 0xB:
+            instruction->op = OP_JUMP_OFFSET;
+            instruction->flow = FLOW_DYNAMIC;
+            break;
+
+        case 0xC:
+            instruction->op = OP_RANDOM;
+            break;
+
+        case 0xD:
+            instruction->op = OP_DRAW;
+            instruction->read_count = n == 0 && mode >= MODE_SCHIP ? 32 : n;
+            if (mode == MODE_XOCHIP) {
+                instruction->read_count *= PLANE_COUNT;
+            }
+            break;
+
+        case 0xE:
+            if (nn == 0x9E) {
+                instruction->op = OP_SKIP_PRESSED;
+                instruction->flow = FLOW_SKIP;
+            }
+            else if (y == 0xA) {
+                instruction->op = OP_SKIP_NOT_PRESSED;
+                instruction->flow = FLOW_SKIP;
+            }
+            else {
+                instruction->flow = FLOW_INVALID;
+            }
+            break;
+
+        case 0xF:
+            switch (nn) {
+                case 0x00:
+                    if (x != 0 || mode != MODE_XOCHIP
+                        || address + 3 >= memory_size) {
+                        instruction->flow = FLOW_INVALID;
+                        break;
+                    }
+                    instruction->op = OP_SET_I_LONG;
+                    instruction->size = 4;
+                    instruction->i_effect = I_SET;
+                    instruction->i_low = instruction->i_high =
+                        memory[address + 2] << 8u | memory[address + 3];
+                    break;
+
+                case 0x01:
+                    instruction->op = OP_SELECT_PLANES;
+                    break;
+
+                case 0x02:
+                    if (x != 0) {
+                        instruction->flow = FLOW_INVALID;
+                        break;
+                    }
+                    instruction->op = OP_LOAD_AUDIO;
+                    instruction->read_count = 16;
+                    break;
+
+                case 0x07:
+                    instruction->op = OP_GET_DELAY;
+                    break;
+
+                case 0x0A:
+                    instruction->op = OP_WAIT_KEY;
+                    break;
+
+                case 0x15:
+                    instruction->op = OP_SET_DELAY;
+                    break;
+
+                case 0x18:
+                    instruction->op = OP_SET_SOUND;
+                    break;
+
+                case 0x1E:
+                    instruction->op = OP_ADD_I;
+                    instruction->i_effect = I_ADD_REGISTER;
+                    break;
+
+                case 0x29:
+                    instruction->op = OP_DIGIT;
+                    instruction->i_effect = I_SET;
+                    instruction->i_low = DIGIT_SPRITE_LOCATION[0x0];
+                    instruction->i_high = DIGIT_SPRITE_LOCATION[0xF];
+                    break;
+
+                case 0x30:
+                    instruction->op = OP_BIG_DIGIT;
+                    instruction->i_effect = I_SET;
+                    instruction->i_low = BIG_DIGIT_SPRITE_LOCATION[0];
+                    instruction->i_high = BIG_DIGIT_SPRITE_LOCATION[9];
+                    break;
+
+                case 0x33:
+                    instruction->op = OP_DECIMAL;
+                    instruction->write_count = 3;
+                    break;
+
+                case 0x3A:
+                    instruction->op = OP_PITCH;
+                    break;
+
+                case 0x55:
+                    instruction->op = OP_STORE;
+                    instruction->write_count = x + 1;
+                    break;
+
+                case 0x65:
+                    instruction->op = OP_LOAD;
+                    instruction->read_count = x + 1;
+                    break;
+
+                case 0x75:
+                    instruction->op = OP_SAVE_FLAGS;
+                    break;
+
+                case 0x85:
+                    instruction->op = OP_LOAD_FLAGS;
+                    break;
+
+                default:
+                    instruction->flow = FLOW_INVALID;
+            }
+            break;
+    }
+
+    /* Gate the extended instructions on the mode that introduced them. */
+    if ((instruction->op >= OP_FIRST_SCHIP && mode < MODE_SCHIP)
+        || (instruction->op >= OP_FIRST_XOCHIP && mode < MODE_XOCHIP)) {
+        instruction->flow = FLOW_INVALID;
+    }
+    if (instruction->flow == FLOW_INVALID) {
+        instruction->op = OP_INVALID;
+    }
+}
+
+/* Add `address` to the disassembly worklist if it has not been seen yet,
+ * marking it as the start of a block if `leader` is set. */
+static void enqueue(struct Analysis *analysis, uint8_t *leaders,
+                    uint32_t *worklist, uint32_t *worklist_length,
+                    uint32_t address, enum bool leader)
+{
+    if (!is_valid_target(address, analysis->memory_size)) {
+        return;
+    }
+    if (leader) {
+        leaders[address] = 1;
+    }
+    if (!(analysis->byte_flags[address] & BYTE_INSTRUCTION)) {
+        analysis->byte_flags[address] |= BYTE_INSTRUCTION;
+        worklist[(*worklist_length)++] = address;
+    }
+}
+
+/* Follow every statically known path from APPLICATION_START, marking each
+ * instruction reached and each address at which a block must start. */
+static void discover(struct Analysis *analysis, const uint8_t *memory,
+                     enum Chip8_mode mode, uint8_t *leaders,
+                     uint32_t *worklist)
+{
+    uint32_t worklist_length = 0;
+    uint32_t memory_size = analysis->memory_size;
+
+    enqueue(analysis, leaders, worklist, &worklist_length,
+            APPLICATION_START, TRUE);
+
+    while (worklist_length > 0) {
+        uint32_t address = worklist[--worklist_length];
+        uint32_t following, i;
+        struct instruction instruction;
+
+        decode(memory, memory_size, mode, address, &instruction);
+        analysis->ops[address] = (uint8_t) instruction.op;
+        for (i = address; i < address + instruction.size && i < memory_size;
+             i++) {
+            analysis->byte_flags[i] |= BYTE_CODE;
+        }
+
+        following = address + instruction.size;
+        switch (instruction.flow) {
+            case FLOW_NEXT:
+                enqueue(analysis, leaders, worklist, &worklist_length,
+                        following, FALSE);
+                break;
+
+            case FLOW_JUMP:
+                enqueue(analysis, leaders, worklist, &worklist_length,
+                        instruction.target, TRUE);
+                break;
+
+            case FLOW_CALL:
+                enqueue(analysis, leaders, worklist, &worklist_length,
+                        instruction.target, TRUE);
+                enqueue(analysis, leaders, worklist, &worklist_length,
+                        following, TRUE);
+                break;
+
+            case FLOW_SKIP:
+                enqueue(analysis, leaders, worklist, &worklist_length,
+                        following, TRUE);
+                enqueue(analysis, leaders, worklist, &worklist_length,
+                        following + size_at(memory, memory_size, mode,
+                                            following), TRUE);
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+/* Record `address` as a successor of `block`, or flag the block if the CPU
+ * could not continue there. */
+static void add_successor(struct Analysis_block *block, uint32_t address,
+                          uint32_t memory_size)
+{
+    if (!is_valid_target(address, memory_size)) {
+        block->flags |= BLOCK_BAD_EXIT;
+        return;
+    }
+    block->successors[block->successor_count++] = (uint16_t) address;
+}
+
+/* Split the discovered instructions into basic blocks. */
+static enum bool build_blocks(struct Analysis *analysis, const uint8_t *memory,
+                              enum Chip8_mode mode, const uint8_t *leaders)
+{
+    uint32_t memory_size = analysis->memory_size;
+    uint32_t capacity = 0;
+    uint32_t address;
+
+    for (address = APPLICATION_START; address < memory_size; address++) {
+        struct Analysis_block *block;
+        struct instruction instruction;
+        uint32_t current = address;
+
+        if (!leaders[address]) {
+            continue;
+        }
+
+        if (analysis->block_count == capacity) {
+            struct Analysis_block *blocks;
+
+            capacity = capacity ? 2 * capacity : 64;
+            blocks = realloc(analysis->blocks, capacity * sizeof *blocks);
+            if (!blocks) {
+                return FALSE;
+            }
+            analysis->blocks = blocks;
+        }
+        block = &analysis->blocks[analysis->block_count++];
+        memset(block, 0, sizeof *block);
+        block->start = (uint16_t) address;
+
+        /* Extend the block until control flow branches or runs
+         * into the start of another block. */
+        for (;;) {
+            decode(memory, memory_size, mode, current, &instruction);
+            if (instruction.flow != FLOW_NEXT
+                || !is_valid_target(current + instruction.size, memory_size)
+                || leaders[current + instruction.size]) {
+                break;
+            }
+            current += instruction.size;
+        }
+        block->end = (uint16_t) (current + instruction.size);
+
+        switch (instruction.flow) {
+            case FLOW_NEXT:
+                add_successor(block, current + instruction.size, memory_size);
+                break;
+
+            case FLOW_JUMP:
+                add_successor(block, instruction.target, memory_size);
+                break;
+
+            case FLOW_CALL:
+                add_successor(block, instruction.target, memory_size);
+                add_successor(block, current + instruction.size, memory_size);
+                break;
+
+            case FLOW_SKIP: {
+                uint32_t following = current + instruction.size;
+                add_successor(block, following, memory_size);
+                add_successor(block, following + size_at(memory, memory_size,
+                                                          mode, following),
+                              memory_size);
+                break;
+            }
+
+            case FLOW_DYNAMIC:
+                block->flags |= BLOCK_DYNAMIC_EXIT;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Return the index of the block starting at `address`, or -1. */
+static int32_t find_index(const struct Analysis *analysis, uint32_t address)
+{
+    int32_t low = 0, high = (int32_t) analysis->block_count - 1;
+
+    while (low <= high) {
+        int32_t middle = low + (high - low) / 2;
+        if (analysis->blocks[middle].start == address) {
+            return middle;
+        }
+        if (analysis->blocks[middle].start < address) {
+            low = middle + 1;
+        }
+        else {
+            high = middle - 1;
+        }
+    }
+    return -1;
+}
+
+/* Apply the effect of `instruction` on I to `i`. */
+static void step_i(struct range *i, const struct instruction *instruction)
+{
+    if (instruction->i_effect == I_SET) {
+        i->low = instruction->i_low;
+        i->high = instruction->i_high;
+    }
+    else if (instruction->i_effect == I_ADD_REGISTER) {
+        i->high += 0xFF;
+        if (i->high > I_MAX) {
+            /* I wraps around, so it could now be anything. */
+            i->low = 0;
+            i->high = I_MAX;
+        }
+    }
+}
+
+/* Merge `from` into the entry state `into`. Return TRUE if it changed. */
+static enum bool merge(struct state *into, const struct state *from)
+{
+    enum bool changed = FALSE;
+    enum bool widen;
+
+    if (!into->reached) {
+        *into = *from;
+        into->update_count = 0;
+        return TRUE;
+    }
+
+    widen = into->update_count >= WIDEN_AFTER ? TRUE : FALSE;
+    if (from->i.low < into->i.low) {
+        into->i.low = widen ? 0 : from->i.low;
+        changed = TRUE;
+    }
+    if (from->i.high > into->i.high) {
+        into->i.high = widen ? I_MAX : from->i.high;
+        changed = TRUE;
+    }
+    if (from->depth.low < into->depth.low) {
+        into->depth.low = from->depth.low;
+        changed = TRUE;
+    }
+    if (from->depth.high > into->depth.high) {
+        into->depth.high = from->depth.high;
+        changed = TRUE;
+    }
+
+    if (changed) {
+        into->update_count++;
+    }
+    return changed;
+}
+
+/* Propagate I and stack depth through the control-flow graph until every
+ * block's entry state is stable. The stack depth is capped one past the
+ * size of the stack, which is enough to know it overflowed. */
+static enum bool propagate(const struct Analysis *analysis,
+                           const uint8_t *memory, enum Chip8_mode mode,
+                           uint8_t stack_size, struct state *states)
+{
+    uint32_t count = analysis->block_count;
+    uint32_t *queue = malloc(count * sizeof *queue);
+    uint8_t *queued = calloc(count, sizeof *queued);
+    uint32_t head = 0, length = 0;
+    int32_t entry = find_index(analysis, APPLICATION_START);
+
+    if (!queue || !queued) {
+        free(queue);
+        free(queued);
+        return FALSE;
+    }
+
+    /* The CPU starts with I and the stack pointer cleared. */
+    assert(entry >= 0);
+    states[entry].reached = TRUE;
+    queue[length++] = (uint32_t) entry;
+    queued[entry] = 1;
+
+    while (length > 0) {
+        const struct Analysis_block *block;
+        struct instruction instruction;
+        struct state exit;
+        uint32_t index = queue[head], address;
+        uint8_t i;
+
+        head = (head + 1) % count;
+        length--;
+        queued[index] = 0;
+
+        block = &analysis->blocks[index];
+        exit = states[index];
+        for (address = block->start; address < block->end;
+             address += instruction.size) {
+            decode(memory, analysis->memory_size, mode, address, &instruction);
+            step_i(&exit.i, &instruction);
+        }
+
+        for (i = 0; i < block->successor_count; i++) {
+            struct state successor = exit;
+            int32_t target = find_index(analysis, block->successors[i]);
+
+            if (instruction.flow == FLOW_CALL && i == 0) {
+                /* Entering the subroutine pushes a return address. */
+                successor.depth.low++;
+                successor.depth.high++;
+                if (successor.depth.low > stack_size + 1) {
+                    successor.depth.low = stack_size + 1;
+                }
+                if (successor.depth.high > stack_size + 1) {
+                    successor.depth.high = stack_size + 1;
+                }
+            }
+            else if (instruction.flow == FLOW_CALL) {
+                /* Returning lands here with the stack as it was before the
+                 * call, but the subroutine may have changed I. */
+                successor.i.low = 0;
+                successor.i.high = I_MAX;
+            }
+
+            assert(target >= 0);
+            if (merge(&states[target], &successor) && !queued[target]) {
+                queue[(head + length) % count] = (uint32_t) target;
+                length++;
+                queued[target] = 1;
+            }
+        }
+    }
+
+    free(queue);
+    free(queued);
+    return TRUE;
+}
+
+/* Set the flags of `byte_flags` from `low` up to (not including) `high`,
+ * clipped to the end of memory. */
+static void mark(struct Analysis *analysis, int32_t low, int32_t high,
+                 uint8_t flags)
+{
+    int32_t address;
+
+    /* Accesses through I wrap around the end of memory. */
+    if (high - low > (int32_t) analysis->memory_size) {
+        high = low + (int32_t) analysis->memory_size;
+    }
+    for (address = low; address < high; address++) {
+        analysis->byte_flags[address % analysis->memory_size] |= flags;
+    }
+}
+
+/* Walk each block from its stable entry state to decide what it proves, and
+ * mark the memory it reads and writes. */
+static void prove(struct Analysis *analysis, const uint8_t *memory,
+                  enum Chip8_mode mode, uint8_t stack_size,
+                  const struct state *states)
+{
+    uint32_t index, address;
+    analysis->complete = TRUE;
+    analysis->stack_proven = TRUE;
+    analysis->max_stack_depth = 0;
+
+    for (index = 0; index < analysis->block_count; index++) {
+        struct Analysis_block *block = &analysis->blocks[index];
+        struct instruction instruction;
+        struct range i = states[index].i;
+        struct range depth = states[index].depth;
+        enum bool i_proven = TRUE;
+
+        for (address = block->start; address < block->end;
+             address += instruction.size) {
+            decode(memory, analysis->memory_size, mode, address, &instruction);
+            step_i(&i, &instruction);
+
+            if (instruction.read_count || instruction.write_count) {
+                uint16_t count = instruction.read_count
+                                 + instruction.write_count;
+
+                if (i.high + count > (int32_t) analysis->memory_size) {
+                    i_proven = FALSE;
+                }
+
+                /* Reads through a wildly unknown I say nothing about what
+                 * is data, but every possible write must be recorded. */
+                if (instruction.read_count && i.high - i.low < 0x100) {
+                    mark(analysis, i.low, i.high + instruction.read_count,
+                         BYTE_DATA);
+                }
+                if (instruction.write_count) {
+                    mark(analysis, i.low, i.high + instruction.write_count,
+                         BYTE_WRITTEN);
+                }
+            }
+        }
+
+        if (i_proven) {
+            block->flags |= BLOCK_I_PROVEN;
+        }
+
+        /* The stack only changes at the end of a block. */
+        if (depth.high <= stack_size
+            && !(instruction.flow == FLOW_CALL && depth.high + 1 > stack_size)
+            && !(instruction.flow == FLOW_RETURN && depth.low < 1)) {
+            block->flags |= BLOCK_STACK_PROVEN;
+            if (depth.high + (instruction.flow == FLOW_CALL)
+                > analysis->max_stack_depth) {
+                analysis->max_stack_depth =
+                    (uint8_t) (depth.high + (instruction.flow == FLOW_CALL));
+            }
+        }
+        else {
+            analysis->stack_proven = FALSE;
+        }
+
+        if (block->flags & BLOCK_DYNAMIC_EXIT) {
+            analysis->complete = FALSE;
+        }
+    }
+
+    /* Code that may be overwritten could branch anywhere afterwards. */
+    for (index = 0; index < analysis->block_count; index++) {
+        struct Analysis_block *block = &analysis->blocks[index];
+
+        for (address = block->start; address < block->end; address++) {
+            if (analysis->byte_flags[address] & BYTE_WRITTEN) {
+                block->flags |= BLOCK_SELF_MODIFYING;
+                analysis->complete = FALSE;
+                break;
+            }
+        }
+    }
+
+    if (!analysis->complete) {
+        return;
+    }
+
+    for (index = 0; index < analysis->block_count; index++) {
+        struct Analysis_block *block = &analysis->blocks[index];
+
+        if (!(block->flags & BLOCK_STACK_PROVEN)
+            || !(block->flags & BLOCK_I_PROVEN)) {
+            continue;
+        }
+        block->flags |= BLOCK_INVARIANTS_PROVEN;
+        for (address = block->start; address < block->end; address++) {
+            if (analysis->byte_flags[address] & BYTE_INSTRUCTION) {
+                analysis->byte_flags[address] |= BYTE_PROVEN;
+            }
+        }
+    }
+}
+
+/* Print each run of bytes having `flag` set, labelled with `name`. */
+static void print_ranges(const struct Analysis *analysis, FILE *out,
+                         uint8_t flag, const char *name)
+{
+    uint32_t address = 0;
+
+    while (address < analysis->memory_size) {
+        uint32_t start;
+
+        if (!(analysis->byte_flags[address] & flag)) {
+            address++;
+            continue;
+        }
+        start = address;
+        while (address < analysis->memory_size
+               && analysis->byte_flags[address] & flag) {
+            address++;
+        }
+        fprintf(out, "%-8s %04x-%04x\n", name, start, address - 1);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Public Interface --------------------------------------------------------- */
+
+enum bool Analysis_run(struct Analysis *analysis, const uint8_t *memory,
+                       uint32_t memory_size, enum Chip8_mode mode)
+{
+    uint8_t stack_size = mode == MODE_CHIP8 ? STACK_SIZE : SCHIP_STACK_SIZE;
+    uint8_t *leaders;
+    uint32_t *worklist;
+    struct state *states;
+    enum bool success;
+
+    memset(analysis, 0, sizeof *analysis);
+    analysis->memory_size = memory_size;
+    analysis->byte_flags = calloc(memory_size, sizeof *analysis->byte_flags);
+    analysis->ops = calloc(memory_size, sizeof *analysis->ops);
+    leaders = calloc(memory_size, sizeof *leaders);
+    worklist = malloc(memory_size * sizeof *worklist);
+    if (!analysis->byte_flags || !analysis->ops || !leaders || !worklist) {
+        free(leaders);
+        free(worklist);
+        Analysis_free(analysis);
+        return FALSE;
+    }
+
+    analysis->quirks = mode == MODE_SCHIP ? QUIRK_JUMP_VX : 0;
+    analysis->cycles_per_frame = CYCLES_PER_DELAY
+                                 * CYCLES_PER_FRAME_SCALE[mode];
+
+    discover(analysis, memory, mode, leaders, worklist);
+    success = build_blocks(analysis, memory, mode, leaders);
+    free(leaders);
+    free(worklist);
+    if (!success) {
+        Analysis_free(analysis);
+        return FALSE;
+    }
+
+    states = calloc(analysis->block_count, sizeof *states);
+    if (!states || !propagate(analysis, memory, mode, stack_size, states)) {
+        free(states);
+        Analysis_free(analysis);
+        return FALSE;
+    }
+
+    prove(analysis, memory, mode, stack_size, states);
+    free(states);
+    return TRUE;
+}
+
+enum bool Analysis_is_proven(const struct Analysis *analysis,
+                             uint32_t address)
+{
+    return address < analysis->memory_size
+           && analysis->byte_flags[address] & BYTE_PROVEN ? TRUE : FALSE;
+}
+
+void Analysis_print(const struct Analysis *analysis, FILE *out)
+{
+    uint32_t index;
+
+    fprintf(out, "%u blocks", (unsigned int) analysis->block_count);
+    if (analysis->stack_proven) {
+        fprintf(out, ", stack depth <= %u",
+                (unsigned int) analysis->max_stack_depth);
+    }
+    else {
+        fprintf(out, ", stack unproven");
+    }
+    fprintf(out, "%s, quirks %x, %u cycles per frame\n",
+            analysis->complete ? "" : ", incomplete",
+            (unsigned int) analysis->quirks,
+            (unsigned int) analysis->cycles_per_frame);
+
+    for (index = 0; index < analysis->block_count; index++) {
+        const struct Analysis_block *block = &analysis->blocks[index];
+        uint8_t i;
+
+        fprintf(out, "block    %04x-%04x ->", block->start, block->end - 1);
+        for (i = 0; i < block->successor_count; i++) {
+            fprintf(out, " %04x", block->successors[i]);
+        }
+        if (block->flags & BLOCK_DYNAMIC_EXIT) {
+            fprintf(out, " dynamic");
+        }
+        if (block->flags & BLOCK_BAD_EXIT) {
+            fprintf(out, " bad");
+        }
+        fprintf(out, " [%s%s%s%s]\n",
+                block->flags & BLOCK_STACK_PROVEN ? "S" : "-",
+                block->flags & BLOCK_I_PROVEN ? "I" : "-",
+                block->flags & BLOCK_SELF_MODIFYING ? "M" : "-",
+                block->flags & BLOCK_INVARIANTS_PROVEN ? "P" : "-");
+    }
+
+    print_ranges(analysis, out, BYTE_DATA, "data");
+    print_ranges(analysis, out, BYTE_WRITTEN, "written");
+}
+
+void Analysis_free(struct Analysis *analysis)
+{
+    if (analysis->mapping) {
+        munmap(analysis->mapping, analysis->mapping_size);
+    }
+    else {
+        free(analysis->byte_flags);
+        free(analysis->ops);
+        free(analysis->blocks);
+    }
+    analysis->mapping = NULL;
+    analysis->byte_flags = NULL;
+    analysis->ops = NULL;
+    analysis->blocks = NULL;
+    analysis->block_count = 0;
+}
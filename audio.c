@@ -0,0 +1,243 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio.h"
+#include "constant.h"
+#include "ring.h"
+
+/* -------------------------------------------------------------------------- */
+/* Private Interface -------------------------------------------------------- */
+
+/* The number of frames of samples the ring holds, a second's worth, which
+ * is how far the output thread may fall behind before samples are dropped.
+ * Hosts running faster than real time fill it up between polls. */
+#define RING_FRAME_COUNT 60
+
+/* The most samples the output thread moves to the sink at once. */
+#define CHUNK_SAMPLE_COUNT 1024
+
+/* How long the output thread sleeps for when the ring is empty. */
+static const long POLL_NS = 1000000;
+
+/* The size of a WAV header, whose sizes are filled in on closing. */
+#define WAV_HEADER_SIZE 44
+
+static enum bool write_null(struct Audio_sink *sink, const int16_t *samples,
+                            size_t count)
+{
+    (void) samples;
+    sink->sample_count += count;
+    return TRUE;
+}
+
+static enum bool close_null(struct Audio_sink *sink)
+{
+    (void) sink;
+    return TRUE;
+}
+
+static enum bool write_raw(struct Audio_sink *sink, const int16_t *samples,
+                           size_t count)
+{
+    sink->sample_count += count;
+    return fwrite(samples, sizeof *samples, count, sink->file) == count
+           ? TRUE : FALSE;
+}
+
+static enum bool close_raw(struct Audio_sink *sink)
+{
+    return fclose(sink->file) == 0 ? TRUE : FALSE;
+}
+
+/* Store `value` at `out` as `size` little endian bytes. */
+static void put_le(uint8_t *out, uint32_t value, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        out[i] = (uint8_t) (value >> (CHAR_BIT_COUNT * i));
+    }
+}
+
+static enum bool write_wav(struct Audio_sink *sink, const int16_t *samples,
+                           size_t count)
+{
+    uint8_t bytes[2 * CHUNK_SAMPLE_COUNT];
+    size_t i;
+
+    /* WAV samples are little endian, whatever the host. */
+    while (count > 0) {
+        size_t chunk = count < CHUNK_SAMPLE_COUNT ? count : CHUNK_SAMPLE_COUNT;
+
+        for (i = 0; i < chunk; i++) {
+            put_le(bytes + 2 * i, (uint16_t) samples[i], 2);
+        }
+        if (fwrite(bytes, 2, chunk, sink->file) != chunk) {
+            return FALSE;
+        }
+        sink->sample_count += chunk;
+        samples += chunk;
+        count -= chunk;
+    }
+    return TRUE;
+}
+
+/* Write the header for `data_size` bytes of samples at the start of
+ * `file`. */
+static enum bool write_wav_header(FILE *file, uint32_t data_size)
+{
+    uint8_t header[WAV_HEADER_SIZE];
+
+    memcpy(header, "RIFF", 4);
+    put_le(header + 4, WAV_HEADER_SIZE - 8 + data_size, 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put_le(header + 16, 16, 4);             /* Format chunk size. */
+    put_le(header + 20, 1, 2);              /* PCM. */
+    put_le(header + 22, 1, 2);              /* Mono. */
+    put_le(header + 24, SAMPLE_RATE, 4);
+    put_le(header + 28, 2 * SAMPLE_RATE, 4); /* Bytes per second. */
+    put_le(header + 32, 2, 2);              /* Bytes per sample. */
+    put_le(header + 34, 16, 2);             /* Bits per sample. */
+    memcpy(header + 36, "data", 4);
+    put_le(header + 40, data_size, 4);
+
+    return fseek(file, 0, SEEK_SET) == 0
+           && fwrite(header, 1, sizeof header, file) == sizeof header
+           ? TRUE : FALSE;
+}
+
+static enum bool close_wav(struct Audio_sink *sink)
+{
+    enum bool success = write_wav_header(sink->file,
+                                         (uint32_t) (2 * sink->sample_count));
+
+    return fclose(sink->file) == 0 && success ? TRUE : FALSE;
+}
+
+/* Output thread: move samples from the ring to the sink until stopped. */
+static void *output(void *argument)
+{
+    struct Audio *audio = argument;
+    int16_t samples[CHUNK_SAMPLE_COUNT];
+
+    for (;;) {
+        /* Checked before reading, so that nothing written before the stop
+         * is left behind. */
+        enum bool stopping = atomic_load(&audio->stopping);
+        size_t size = Ring_read(&audio->ring, samples, sizeof samples);
+
+        if (size > 0) {
+            if (!audio->sink.write(&audio->sink, samples,
+                                   size / sizeof *samples)) {
+                atomic_store(&audio->failed, TRUE);
+                return NULL;
+            }
+        }
+        else if (stopping) {
+            return NULL;
+        }
+        else {
+            struct timespec poll = {0, POLL_NS};
+
+            nanosleep(&poll, NULL);
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Public Interface --------------------------------------------------------- */
+
+void Audio_open_null_sink(struct Audio_sink *sink)
+{
+    sink->write = write_null;
+    sink->close = close_null;
+    sink->file = NULL;
+    sink->sample_count = 0;
+}
+
+enum bool Audio_open_raw_sink(struct Audio_sink *sink, const char *file_name)
+{
+    sink->file = fopen(file_name, "wb");
+    if (!sink->file) {
+        fprintf(stderr, "The audio file '%s' could not be opened.\n",
+                file_name);
+        return FALSE;
+    }
+    sink->write = write_raw;
+    sink->close = close_raw;
+    sink->sample_count = 0;
+    return TRUE;
+}
+
+enum bool Audio_open_wav_sink(struct Audio_sink *sink, const char *file_name)
+{
+    /* Until the real size is known on closing, the header claims as much
+     * as it can hold, which players take to mean "up to the end of the
+     * file"; this keeps recordings cut short by a signal playable. */
+    sink->file = fopen(file_name, "wb");
+    if (!sink->file
+        || !write_wav_header(sink->file, UINT32_MAX - WAV_HEADER_SIZE)) {
+        fprintf(stderr, "The audio file '%s' could not be opened.\n",
+                file_name);
+        if (sink->file) {
+            fclose(sink->file);
+        }
+        return FALSE;
+    }
+    sink->write = write_wav;
+    sink->close = close_wav;
+    sink->sample_count = 0;
+    return TRUE;
+}
+
+enum bool Audio_open_sink(struct Audio_sink *sink, const char *name)
+{
+    size_t length = strlen(name);
+
+    if (strcmp(name, "null") == 0) {
+        Audio_open_null_sink(sink);
+        return TRUE;
+    }
+    if (length >= 4 && strcmp(name + length - 4, ".wav") == 0) {
+        return Audio_open_wav_sink(sink, name);
+    }
+    return Audio_open_raw_sink(sink, name);
+}
+
+enum bool Audio_start(struct Audio *audio, const struct Audio_sink *sink)
+{
+    audio->sink = *sink;
+    atomic_init(&audio->stopping, FALSE);
+    atomic_init(&audio->failed, FALSE);
+
+    if (!Ring_init(&audio->ring, RING_FRAME_COUNT * SAMPLES_PER_FRAME
+                                 * sizeof(int16_t))) {
+        audio->sink.close(&audio->sink);
+        return FALSE;
+    }
+    if (pthread_create(&audio->thread, NULL, output, audio) != 0) {
+        Ring_uninit(&audio->ring);
+        audio->sink.close(&audio->sink);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+enum bool Audio_stop(struct Audio *audio)
+{
+    enum bool success;
+
+    atomic_store(&audio->stopping, TRUE);
+    pthread_join(audio->thread, NULL);
+
+    success = !atomic_load(&audio->failed);
+    success = audio->sink.close(&audio->sink) && success ? TRUE : FALSE;
+    Ring_uninit(&audio->ring);
+
+    return success;
+}
@@ -0,0 +1,252 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "analysis.h"
+#include "cache.h"
+#include "constant.h"
+#include "hash.h"
+
+/* A cache file is this header followed by the byte flags and instruction
+ * table (memory_size bytes each), the blocks and then the ROM the analysis
+ * is of. Everything is in the
+ * host's byte order and layout; the cache is not meant to be shared between
+ * machines. */
+struct header {
+    char magic[4];
+    uint32_t version;
+    uint64_t rom_hash;
+    uint32_t mode;
+    uint32_t memory_size;
+    uint32_t block_count;
+    uint32_t rom_size;
+    uint16_t cycles_per_frame;
+    uint8_t quirks;
+    uint8_t max_stack_depth;
+    uint8_t stack_proven;
+    uint8_t complete;
+    uint8_t padding[2];
+};
+
+static const char MAGIC[4] = {'C', '8', 'A', 'C'};
+
+/* Bump whenever the file layout or the analysis itself changes, so that
+ * stale entries are ignored. */
+static const uint32_t VERSION = 4;
+
+/* Longest path of a cache file that will be built. */
+#define PATH_SIZE 4096
+
+/* -------------------------------------------------------------------------- */
+/* Private Interface -------------------------------------------------------- */
+
+/* Write the cache directory into `path`. Return FALSE if there is none. */
+static enum bool directory_path(char *path)
+{
+    const char *directory = getenv("CHIP8_CACHE_DIR");
+    int length;
+
+    if (directory && *directory) {
+        length = snprintf(path, PATH_SIZE, "%s", directory);
+    }
+    else if ((directory = getenv("XDG_CACHE_HOME")) && *directory) {
+        length = snprintf(path, PATH_SIZE, "%s/chip8", directory);
+    }
+    else if ((directory = getenv("HOME")) && *directory) {
+        length = snprintf(path, PATH_SIZE, "%s/.cache/chip8", directory);
+    }
+    else {
+        return FALSE;
+    }
+
+    return length > 0 && length < PATH_SIZE ? TRUE : FALSE;
+}
+
+/* Write the path of the entry for `rom_hash` in `mode` into `path`. */
+static enum bool entry_path(char *path, uint64_t rom_hash,
+                            enum Chip8_mode mode)
+{
+    char directory[PATH_SIZE];
+    int length;
+
+    if (!directory_path(directory)) {
+        return FALSE;
+    }
+    length = snprintf(path, PATH_SIZE, "%s/%016llx-%d.c8a", directory,
+                      (unsigned long long) rom_hash, (int) mode);
+    return length > 0 && length < PATH_SIZE ? TRUE : FALSE;
+}
+
+/* Create the directory at `path` and any missing parents. */
+static enum bool make_directories(char *path)
+{
+    char *separator;
+
+    for (separator = strchr(path + 1, '/'); separator;
+         separator = strchr(separator + 1, '/')) {
+        *separator = '\0';
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+            *separator = '/';
+            return FALSE;
+        }
+        *separator = '/';
+    }
+    return mkdir(path, 0755) == 0 || errno == EEXIST ? TRUE : FALSE;
+}
+
+/* Return the size of a cache file holding the given analysis. */
+static size_t file_size(uint32_t memory_size, uint32_t block_count,
+                        uint32_t rom_size)
+{
+    return sizeof(struct header) + 2 * (size_t) memory_size
+           + block_count * sizeof(struct Analysis_block) + rom_size;
+}
+
+/* Write all `length` bytes at `data` to `fd`. */
+static enum bool write_all(int fd, const void *data, size_t length)
+{
+    const uint8_t *bytes = data;
+
+    while (length > 0) {
+        ssize_t written = write(fd, bytes, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return FALSE;
+        }
+        bytes += written;
+        length -= (size_t) written;
+    }
+    return TRUE;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Public Interface --------------------------------------------------------- */
+
+enum bool Cache_load(struct Analysis *analysis, const uint8_t *rom,
+                     size_t rom_size, enum Chip8_mode mode,
+                     uint32_t memory_size)
+{
+    uint64_t rom_hash = Hash_xxh64(rom, rom_size, 0);
+    char path[PATH_SIZE];
+    const struct header *header;
+    struct stat status;
+    uint8_t *mapping;
+    size_t size;
+    int fd;
+
+    if (!entry_path(path, rom_hash, mode)) {
+        return FALSE;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return FALSE;
+    }
+    if (fstat(fd, &status) != 0
+        || (size_t) status.st_size < sizeof *header) {
+        close(fd);
+        return FALSE;
+    }
+
+    /* The mapping stays valid once the descriptor is closed. */
+    mapping = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return FALSE;
+    }
+
+    header = (const struct header *) mapping;
+    if (memcmp(header->magic, MAGIC, sizeof MAGIC) != 0
+        || header->version != VERSION
+        || header->rom_hash != rom_hash
+        || header->mode != (uint32_t) mode
+        || header->memory_size != memory_size
+        || header->rom_size != rom_size
+        || (size_t) status.st_size != (size = file_size(header->memory_size,
+                                                        header->block_count,
+                                                        header->rom_size))
+        || memcmp(mapping + size - rom_size, rom, rom_size) != 0) {
+        munmap(mapping, (size_t) status.st_size);
+        return FALSE;
+    }
+
+    /* Point the analysis straight into the mapping. The tables are never
+     * written to once the analysis is built. */
+    memset(analysis, 0, sizeof *analysis);
+    analysis->memory_size = header->memory_size;
+    analysis->byte_flags = mapping + sizeof *header;
+    analysis->ops = analysis->byte_flags + header->memory_size;
+    analysis->blocks = (struct Analysis_block *)
+                       (analysis->ops + header->memory_size);
+    analysis->block_count = header->block_count;
+    analysis->stack_proven = header->stack_proven ? TRUE : FALSE;
+    analysis->max_stack_depth = header->max_stack_depth;
+    analysis->complete = header->complete ? TRUE : FALSE;
+    analysis->quirks = header->quirks;
+    analysis->cycles_per_frame = header->cycles_per_frame;
+    analysis->mapping = mapping;
+    analysis->mapping_size = (size_t) status.st_size;
+
+    return TRUE;
+}
+
+enum bool Cache_store(const struct Analysis *analysis, const uint8_t *rom,
+                      size_t rom_size, enum Chip8_mode mode)
+{
+    uint64_t rom_hash = Hash_xxh64(rom, rom_size, 0);
+    char directory[PATH_SIZE], path[PATH_SIZE], temporary[PATH_SIZE];
+    struct header header;
+    enum bool written;
+    int fd;
+
+    if (!directory_path(directory) || !make_directories(directory)
+        || !entry_path(path, rom_hash, mode)) {
+        return FALSE;
+    }
+    if (snprintf(temporary, PATH_SIZE, "%s.XXXXXX", path) >= PATH_SIZE) {
+        return FALSE;
+    }
+
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, MAGIC, sizeof MAGIC);
+    header.version = VERSION;
+    header.rom_hash = rom_hash;
+    header.mode = (uint32_t) mode;
+    header.memory_size = analysis->memory_size;
+    header.block_count = analysis->block_count;
+    header.rom_size = (uint32_t) rom_size;
+    header.cycles_per_frame = analysis->cycles_per_frame;
+    header.quirks = analysis->quirks;
+    header.max_stack_depth = analysis->max_stack_depth;
+    header.stack_proven = analysis->stack_proven ? 1 : 0;
+    header.complete = analysis->complete ? 1 : 0;
+
+    /* Write to a private file first and rename it into place, so that
+     * concurrent launches, or machines in other threads, never map a
+     * partially written entry. */
+    fd = mkstemp(temporary);
+    if (fd < 0) {
+        return FALSE;
+    }
+    fchmod(fd, 0644);
+    written = write_all(fd, &header, sizeof header)
+              && write_all(fd, analysis->byte_flags, analysis->memory_size)
+              && write_all(fd, analysis->ops, analysis->memory_size)
+              && write_all(fd, analysis->blocks, analysis->block_count
+                                                 * sizeof *analysis->blocks)
+              && write_all(fd, rom, rom_size);
+    if (close(fd) != 0 || !written || rename(temporary, path) != 0) {
+        unlink(temporary);
+        return FALSE;
+    }
+
+    return TRUE;
+}
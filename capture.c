@@ -0,0 +1,586 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "capture.h"
+#include "chip8.h"
+#include "constant.h"
+#include "ring.h"
+
+/* -------------------------------------------------------------------------- */
+/* Private Interface -------------------------------------------------------- */
+
+/* The file header: a magic number and a version. */
+static const char HEADER_MAGIC[] = "CHIP8CAP";
+static const uint32_t VERSION = 1;
+#define HEADER_SIZE 12
+
+/* The trailer: the offset of the index, the number of keyframes and frames,
+ * the number of dropped frames and a magic number. */
+static const char TRAILER_MAGIC[] = "CHIP8IDX";
+#define TRAILER_SIZE 32
+
+/* An index entry: a keyframe's frame number and offset. */
+#define INDEX_ENTRY_SIZE 12
+
+/* A record header: the record type, frame number, width, height and the
+ * size of the run-length coded framebuffer which follows. */
+enum record_type {RECORD_KEYFRAME = 1, RECORD_DELTA};
+#define RECORD_HEADER_SIZE 11
+
+/* In the run-length code, a control byte below RUN_LITERAL is followed by
+ * nothing and stands for one more zero byte than its value; one at or
+ * above it is followed by one more literal byte than its value less
+ * RUN_LITERAL. */
+#define RUN_LITERAL 0x80
+#define MAX_RUN 128
+
+/* The number of frames of the largest records the ring holds. */
+#define RING_RECORD_COUNT 512
+
+/* How many frames may pass between keyframes, bounding the work of seeking
+ * to a frame; ten seconds' worth. */
+static const uint32_t KEYFRAME_INTERVAL = 600;
+
+/* How long the writer thread sleeps for when the ring is empty. */
+static const long POLL_NS = 1000000;
+
+/* Return the number of words in the framebuffer. */
+static size_t frame_word_count(void)
+{
+    return (size_t) PLANE_COUNT * PLANE_WORD_COUNT;
+}
+
+/* Return the size of the framebuffer in bytes. */
+static size_t frame_size(void)
+{
+    return frame_word_count() * sizeof(uint64_t);
+}
+
+/* Return the largest size a run-length coded framebuffer can take. */
+static size_t max_payload_size(void)
+{
+    return frame_size() + (frame_size() + MAX_RUN - 1) / MAX_RUN;
+}
+
+/* Store `value` at `out` as `size` little endian bytes. */
+static void put_le(uint8_t *out, uint64_t value, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        out[i] = (uint8_t) (value >> (CHAR_BIT_COUNT * i));
+    }
+}
+
+/* Return the `size` little endian bytes at `in`. */
+static uint64_t get_le(const uint8_t *in, size_t size)
+{
+    uint64_t value = 0;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        value |= (uint64_t) in[i] << (CHAR_BIT_COUNT * i);
+    }
+    return value;
+}
+
+/* Run-length code the `size` bytes at `bytes` into `out`, returning the
+ * coded size. Runs of zeros, which make up nearly all of a delta and most
+ * of a frame, shrink to a byte; a lone zero between other bytes is kept as
+ * a literal rather than breaking it up. */
+static size_t encode_runs(const uint8_t *bytes, size_t size, uint8_t *out)
+{
+    size_t length = 0;
+    size_t i = 0;
+
+    while (i < size) {
+        size_t start = i;
+
+        while (i < size && bytes[i] == 0 && i - start < MAX_RUN) {
+            i++;
+        }
+        if (i > start) {
+            out[length++] = (uint8_t) (i - start - 1);
+            continue;
+        }
+
+        while (i < size && i - start < MAX_RUN
+               && (bytes[i] != 0 || (i + 1 < size && bytes[i + 1] != 0))) {
+            i++;
+        }
+        out[length++] = (uint8_t) (RUN_LITERAL + i - start - 1);
+        memcpy(out + length, bytes + start, i - start);
+        length += i - start;
+    }
+
+    return length;
+}
+
+/* Decode the `length` run-length coded bytes at `in` onto the framebuffer
+ * bytes at `bytes`, replacing them for a keyframe and XORing them in for a
+ * delta. Return FALSE if the code is malformed. */
+static enum bool decode_runs(const uint8_t *in, size_t length, uint8_t *bytes,
+                             enum bool keyframe)
+{
+    size_t size = frame_size();
+    size_t i = 0;
+    size_t at = 0;
+
+    while (i < length) {
+        uint8_t control = in[i++];
+        size_t count = (size_t) (control & (RUN_LITERAL - 1)) + 1;
+        size_t j;
+
+        if (at + count > size) {
+            return FALSE;
+        }
+        if (control < RUN_LITERAL) {
+            if (keyframe) {
+                memset(bytes + at, 0, count);
+            }
+        }
+        else {
+            if (i + count > length) {
+                return FALSE;
+            }
+            for (j = 0; j < count; j++) {
+                bytes[at + j] = (uint8_t) (keyframe ? in[i + j]
+                                                    : bytes[at + j]
+                                                      ^ in[i + j]);
+            }
+            i += count;
+        }
+        at += count;
+    }
+
+    return at == size ? TRUE : FALSE;
+}
+
+/* Add an entry for a keyframe of frame `frame` at `offset` to the index at
+ * `keyframes`. Return FALSE on error. */
+static enum bool add_keyframe(struct Capture_keyframe **keyframes,
+                              uint32_t *count, uint32_t *capacity,
+                              uint32_t frame, uint64_t offset)
+{
+    if (*count == *capacity) {
+        uint32_t new_capacity = *capacity ? 2 * *capacity : 64;
+        struct Capture_keyframe *grown =
+            realloc(*keyframes, new_capacity * sizeof *grown);
+
+        if (!grown) {
+            return FALSE;
+        }
+        *keyframes = grown;
+        *capacity = new_capacity;
+    }
+
+    (*keyframes)[*count].frame = frame;
+    (*keyframes)[*count].offset = offset;
+    (*count)++;
+    return TRUE;
+}
+
+/* Writer thread: move records from the ring to the file, indexing the
+ * keyframes, until stopped. */
+static void *write_records(void *argument)
+{
+    struct Capture *capture = argument;
+    uint8_t *payload = malloc(max_payload_size());
+
+    if (!payload) {
+        atomic_store(&capture->failed, TRUE);
+        return NULL;
+    }
+
+    for (;;) {
+        /* Checked before reading, so that nothing captured before the stop
+         * is left behind. */
+        enum bool stopping = atomic_load(&capture->stopping);
+        uint8_t header[RECORD_HEADER_SIZE];
+        size_t payload_size;
+
+        /* Records go into the ring whole, so a record is either all there
+         * or not there at all. */
+        if (Ring_read(&capture->ring, header, sizeof header) == 0) {
+            struct timespec poll = {0, POLL_NS};
+
+            if (stopping) {
+                break;
+            }
+            nanosleep(&poll, NULL);
+            continue;
+        }
+        payload_size = (size_t) get_le(header + 9, 2);
+        Ring_read(&capture->ring, payload, payload_size);
+
+        if ((header[0] == RECORD_KEYFRAME
+             && !add_keyframe(&capture->keyframes, &capture->keyframe_count,
+                              &capture->keyframe_capacity,
+                              (uint32_t) get_le(header + 1, 4),
+                              capture->offset))
+            || fwrite(header, 1, sizeof header, capture->file)
+               != sizeof header
+            || fwrite(payload, 1, payload_size, capture->file)
+               != payload_size) {
+            atomic_store(&capture->failed, TRUE);
+            break;
+        }
+        capture->offset += sizeof header + payload_size;
+    }
+
+    free(payload);
+    return NULL;
+}
+
+/* Write the index and trailer of `capture` at the end of its file. Return
+ * FALSE on error. */
+static enum bool write_index(const struct Capture *capture)
+{
+    uint8_t entry[INDEX_ENTRY_SIZE];
+    uint8_t trailer[TRAILER_SIZE];
+    uint32_t i;
+
+    for (i = 0; i < capture->keyframe_count; i++) {
+        put_le(entry, capture->keyframes[i].frame, 4);
+        put_le(entry + 4, capture->keyframes[i].offset, 8);
+        if (fwrite(entry, 1, sizeof entry, capture->file) != sizeof entry) {
+            return FALSE;
+        }
+    }
+
+    put_le(trailer, capture->offset, 8);
+    put_le(trailer + 8, capture->keyframe_count, 4);
+    put_le(trailer + 12, capture->frame_count, 4);
+    put_le(trailer + 16, capture->dropped_frame_count, 8);
+    memcpy(trailer + 24, TRAILER_MAGIC, 8);
+    return fwrite(trailer, 1, sizeof trailer, capture->file) == sizeof trailer
+           ? TRUE : FALSE;
+}
+
+/* Return TRUE iff. the record `header` could follow records up to frame
+ * `frame_count` in a file, checking everything that can be checked before
+ * reading the payload. */
+static enum bool is_record(const uint8_t *header, uint32_t frame_count)
+{
+    uint32_t frame = (uint32_t) get_le(header + 1, 4);
+    uint16_t width = (uint16_t) get_le(header + 5, 2);
+    uint16_t height = (uint16_t) get_le(header + 7, 2);
+
+    return (header[0] == RECORD_KEYFRAME
+            || (header[0] == RECORD_DELTA && frame_count > 0))
+           && frame >= frame_count
+           && width > 0 && width <= HIRES_WIDTH_PIXEL_COUNT
+           && height > 0 && height <= HIRES_HEIGHT_PIXEL_COUNT
+           && get_le(header + 9, 2) <= max_payload_size() ? TRUE : FALSE;
+}
+
+/* Rebuild the index of a capture file without one by reading through its
+ * records, keeping those which were written whole, up to the first that
+ * cannot be a record (such as the start of an index whose trailer was cut
+ * off). Return FALSE on error. */
+static enum bool scan_records(struct Capture_reader *reader)
+{
+    uint32_t capacity = 0;
+    uint8_t header[RECORD_HEADER_SIZE];
+    uint64_t offset = HEADER_SIZE;
+
+    reader->frame_count = 0;
+    reader->dropped_frame_count = 0;
+    if (fseek(reader->file, HEADER_SIZE, SEEK_SET) != 0) {
+        return FALSE;
+    }
+
+    while (fread(header, 1, sizeof header, reader->file) == sizeof header
+           && is_record(header, reader->frame_count)) {
+        uint32_t frame = (uint32_t) get_le(header + 1, 4);
+        long payload_size = (long) get_le(header + 9, 2);
+
+        /* A record is whole if its last byte is there. */
+        if (payload_size > 0
+            && (fseek(reader->file, payload_size - 1, SEEK_CUR) != 0
+                || fgetc(reader->file) == EOF)) {
+            break;
+        }
+        if (header[0] == RECORD_KEYFRAME
+            && !add_keyframe(&reader->keyframes, &reader->keyframe_count,
+                             &capacity, frame, offset)) {
+            return FALSE;
+        }
+        offset += RECORD_HEADER_SIZE + (uint64_t) payload_size;
+        reader->frame_count = frame + 1;
+    }
+
+    reader->records_end = offset;
+    return TRUE;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Public Interface --------------------------------------------------------- */
+
+enum bool Capture_start(struct Capture *capture, const char *file_name)
+{
+    uint8_t header[HEADER_SIZE];
+
+    memset(capture, 0, sizeof *capture);
+    atomic_init(&capture->stopping, FALSE);
+    atomic_init(&capture->failed, FALSE);
+
+    capture->reference = malloc(frame_size());
+    capture->record = malloc(frame_size() + RECORD_HEADER_SIZE
+                             + max_payload_size());
+    if (!capture->reference || !capture->record
+        || !Ring_init(&capture->ring, RING_RECORD_COUNT
+                                      * (RECORD_HEADER_SIZE
+                                         + max_payload_size()))) {
+        free(capture->record);
+        free(capture->reference);
+        return FALSE;
+    }
+
+    memcpy(header, HEADER_MAGIC, 8);
+    put_le(header + 8, VERSION, 4);
+    capture->file = fopen(file_name, "wb");
+    if (!capture->file
+        || fwrite(header, 1, sizeof header, capture->file) != sizeof header) {
+        fprintf(stderr, "The capture file '%s' could not be opened.\n",
+                file_name);
+        if (capture->file) {
+            fclose(capture->file);
+        }
+        Ring_uninit(&capture->ring);
+        free(capture->record);
+        free(capture->reference);
+        return FALSE;
+    }
+    capture->offset = HEADER_SIZE;
+
+    if (pthread_create(&capture->thread, NULL, write_records,
+                       capture) != 0) {
+        fclose(capture->file);
+        Ring_uninit(&capture->ring);
+        free(capture->record);
+        free(capture->reference);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+void Capture_frame(struct Capture *capture, const struct Chip8 *chip8)
+{
+    uint16_t width, height;
+    const uint64_t *display = Chip8_framebuffer(chip8, &width, &height);
+    uint32_t frame = capture->frame_count++;
+    /* The framebuffer bytes go after the record, out of the way. */
+    uint8_t *bytes = capture->record + RECORD_HEADER_SIZE
+                     + max_payload_size();
+    size_t word_count = frame_word_count();
+    enum bool keyframe;
+    size_t payload_size;
+    size_t i, j;
+
+    /* Most frames are just like the one before, and cost only this. */
+    if (capture->has_keyframe && width == capture->width
+        && height == capture->height
+        && memcmp(display, capture->reference, frame_size()) == 0) {
+        return;
+    }
+
+    keyframe = !capture->has_keyframe
+               || frame - capture->keyframe_frame
+                  >= KEYFRAME_INTERVAL ? TRUE : FALSE;
+
+    /* Words are stored most significant byte first, which keeps pixels in
+     * order across bytes whatever the host's byte order. */
+    for (i = 0; i < word_count; i++) {
+        uint64_t word = keyframe ? display[i]
+                                 : display[i] ^ capture->reference[i];
+
+        for (j = 0; j < sizeof word; j++) {
+            bytes[i * sizeof word + j] =
+                (uint8_t) (word >> (CHAR_BIT_COUNT * (sizeof word - 1 - j)));
+        }
+    }
+    payload_size = encode_runs(bytes, frame_size(),
+                               capture->record + RECORD_HEADER_SIZE);
+
+    capture->record[0] = keyframe ? RECORD_KEYFRAME : RECORD_DELTA;
+    put_le(capture->record + 1, frame, 4);
+    put_le(capture->record + 5, width, 2);
+    put_le(capture->record + 7, height, 2);
+    put_le(capture->record + 9, payload_size, 2);
+
+    /* A dropped frame leaves the reference alone, so the next record is a
+     * delta from what the file does hold. */
+    if (!Ring_write(&capture->ring, capture->record,
+                    RECORD_HEADER_SIZE + payload_size)) {
+        capture->dropped_frame_count++;
+        return;
+    }
+
+    memcpy(capture->reference, display, frame_size());
+    capture->width = width;
+    capture->height = height;
+    if (keyframe) {
+        capture->has_keyframe = TRUE;
+        capture->keyframe_frame = frame;
+    }
+}
+
+enum bool Capture_has_room(struct Capture *capture)
+{
+    return Ring_free_size(&capture->ring)
+           >= RECORD_HEADER_SIZE + max_payload_size() ? TRUE : FALSE;
+}
+
+enum bool Capture_stop(struct Capture *capture)
+{
+    enum bool success;
+
+    atomic_store(&capture->stopping, TRUE);
+    pthread_join(capture->thread, NULL);
+
+    success = !atomic_load(&capture->failed) && write_index(capture);
+    success = fclose(capture->file) == 0 && success ? TRUE : FALSE;
+
+    free(capture->keyframes);
+    Ring_uninit(&capture->ring);
+    free(capture->record);
+    free(capture->reference);
+    return success;
+}
+
+enum bool Capture_open(struct Capture_reader *reader, const char *file_name)
+{
+    uint8_t header[HEADER_SIZE];
+    uint8_t trailer[TRAILER_SIZE];
+    enum bool indexed;
+    uint32_t i;
+
+    memset(reader, 0, sizeof *reader);
+    reader->file = fopen(file_name, "rb");
+    if (!reader->file
+        || fread(header, 1, sizeof header, reader->file) != sizeof header
+        || memcmp(header, HEADER_MAGIC, 8) != 0
+        || get_le(header + 8, 4) != VERSION) {
+        fprintf(stderr, "'%s' is not a capture file.\n", file_name);
+        if (reader->file) {
+            fclose(reader->file);
+        }
+        return FALSE;
+    }
+
+    indexed = fseek(reader->file, -TRAILER_SIZE, SEEK_END) == 0
+              && fread(trailer, 1, sizeof trailer, reader->file)
+                 == sizeof trailer
+              && memcmp(trailer + 24, TRAILER_MAGIC, 8) == 0;
+    if (!indexed) {
+        if (!scan_records(reader)) {
+            Capture_close(reader);
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    reader->records_end = get_le(trailer, 8);
+    reader->keyframe_count = (uint32_t) get_le(trailer + 8, 4);
+    reader->frame_count = (uint32_t) get_le(trailer + 12, 4);
+    reader->dropped_frame_count = get_le(trailer + 16, 8);
+    reader->keyframes = malloc((reader->keyframe_count + 1)
+                               * sizeof *reader->keyframes);
+    if (!reader->keyframes
+        || fseek(reader->file, (long) reader->records_end, SEEK_SET) != 0) {
+        Capture_close(reader);
+        return FALSE;
+    }
+    for (i = 0; i < reader->keyframe_count; i++) {
+        uint8_t entry[INDEX_ENTRY_SIZE];
+
+        if (fread(entry, 1, sizeof entry, reader->file) != sizeof entry) {
+            Capture_close(reader);
+            return FALSE;
+        }
+        reader->keyframes[i].frame = (uint32_t) get_le(entry, 4);
+        reader->keyframes[i].offset = get_le(entry + 4, 8);
+    }
+
+    return TRUE;
+}
+
+enum bool Capture_seek(struct Capture_reader *reader, uint32_t frame,
+                       uint64_t *display, uint16_t *width, uint16_t *height)
+{
+    uint8_t *bytes = malloc(frame_size());
+    uint8_t *payload = malloc(max_payload_size());
+    uint32_t low = 0;
+    uint32_t high = reader->keyframe_count;
+    uint64_t offset;
+    enum bool found = FALSE;
+    enum bool valid = TRUE;
+    size_t i, j;
+
+    /* Find the last keyframe at or before the frame. */
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+
+        if (reader->keyframes[middle].frame <= frame) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    if (!bytes || !payload || low == 0 || frame >= reader->frame_count) {
+        free(payload);
+        free(bytes);
+        return FALSE;
+    }
+
+    /* Apply it and the deltas after it, up to the frame. */
+    offset = reader->keyframes[low - 1].offset;
+    while (valid && offset < reader->records_end) {
+        uint8_t header[RECORD_HEADER_SIZE];
+        size_t payload_size;
+
+        if (fseek(reader->file, (long) offset, SEEK_SET) != 0
+            || fread(header, 1, sizeof header, reader->file)
+               != sizeof header
+            || get_le(header + 1, 4) > frame) {
+            break;
+        }
+        payload_size = (size_t) get_le(header + 9, 2);
+        valid = payload_size <= max_payload_size()
+                && fread(payload, 1, payload_size, reader->file) == payload_size
+                && decode_runs(payload, payload_size, bytes,
+                               header[0] == RECORD_KEYFRAME);
+        *width = (uint16_t) get_le(header + 5, 2);
+        *height = (uint16_t) get_le(header + 7, 2);
+        found = TRUE;
+        offset += sizeof header + payload_size;
+    }
+
+    for (i = 0; i < frame_word_count(); i++) {
+        uint64_t word = 0;
+
+        for (j = 0; j < sizeof word; j++) {
+            word = word << CHAR_BIT_COUNT | bytes[i * sizeof word + j];
+        }
+        display[i] = word;
+    }
+
+    free(payload);
+    free(bytes);
+    return found && valid ? TRUE : FALSE;
+}
+
+void Capture_close(struct Capture_reader *reader)
+{
+    free(reader->keyframes);
+    fclose(reader->file);
+    memset(reader, 0, sizeof *reader);
+}
@@ -1,115 +1,560 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <assert.h>
-#include <unistd.h>
 #include <stdio.h>
+#include <string.h>
 
+#include "analysis.h"
+#include "cache.h"
 #include "chip8.h"
 #include "cpu.h"
+#include "hash.h"
+#include "image.h"
 #include "input.h"
-#include "port.h"
+#include "recompiled.h"
 #include "screen.h"
+#include "sound.h"
 
-/* The system's main memory (RAM). */
-static uint8_t *memory;
+/* Saved states store memory and the display in chunks of this many bytes,
+ * leaving out the chunks which are as they were at power on. */
+#define STATE_CHUNK_SIZE 64
 
-/* Emulate the CHIP-8 system, loading in a ROM from the file specified by the
- * first command line argument. */
-int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <rom_file>\n", argv[0]);
-        return EXIT_FAILURE;
+/* The fixed size part of a saved state. The pointers held by the modules are
+ * not restored, and the chunk bitmaps and chunks follow. */
+struct state_header {
+    struct Cpu cpu;
+    struct Screen screen;
+    struct Input input;
+    uint32_t frame_cycles;
+};
+
+/* The part of the state hashed besides memory and the display, kept free of
+ * padding and pointers so that equal states hash equally. */
+struct hashed_registers {
+    uint64_t random_state;
+    uint16_t stack[16];
+    uint16_t program_counter;
+    uint16_t I;
+    int16_t stack_pointer;
+    int16_t delay_timer;
+    int16_t sound_timer;
+    uint16_t width;
+    uint16_t held_keys;
+    uint16_t pressed_keys;
+    uint8_t register_v[16];
+    uint8_t flag_registers[16];
+    uint8_t audio_pattern[16];
+    uint8_t pitch;
+    uint8_t selected_planes;
+    uint8_t waiting_for_key;
+    uint8_t halted;
+};
+
+struct Chip8 {
+    /* The instruction set being emulated. */
+    enum Chip8_mode mode;
+
+    /* TRUE iff. an application is loaded and the fields below are set. */
+    enum bool loaded;
+
+    /* The pristine memory image holding the interpreter data and the ROM,
+     * which may be shared with other machines running the same ROM. */
+    struct Image *image;
+
+    /* The system's main memory (RAM), a copy-on-write view of the image. */
+    uint8_t *memory;
+
+    /* Static analysis of the loaded application, held by the image. */
+    const struct Analysis *analysis;
+
+    /* The hardware modules. */
+    struct Cpu cpu;
+    struct Screen screen;
+    struct Input input;
+
+    /* The number of cycles run since the start of the current frame, and
+     * since the application was loaded. */
+    uint32_t frame_cycles;
+    uint64_t cycle_count;
+
+    /* The ring the machine's sound goes to, or NULL, and its generator,
+     * which is set up while an application is loaded. */
+    struct Ring *audio;
+    struct Sound sound;
+
+    /* When the application was translated ahead of time, the translated
+     * block starting at each address of memory, or NULL. */
+    const struct Recompiled_block **dispatch;
+};
+
+/* -------------------------------------------------------------------------- */
+/* Private Interface -------------------------------------------------------- */
+
+/* Fill in the analysis for the ROM in the image, reusing the cached result
+ * from an earlier run of the same ROM if there is one. Return TRUE on
+ * success and FALSE on error. */
+static enum bool analyse(struct Chip8 *chip8) {
+    struct Image *image = chip8->image;
+    const uint8_t *rom = image->data + APPLICATION_START;
+
+    /* Machines sharing the image run the same mode, and share its
+     * analysis. */
+    if (image->analysed) {
+        chip8->analysis = &image->analysis;
+        return TRUE;
     }
 
-    return Chip8_turn_on(argv[1]) ? EXIT_SUCCESS : EXIT_FAILURE;
+    if (!Cache_load(&image->analysis, rom, image->rom_size, chip8->mode,
+                    image->memory_size)) {
+        if (!Analysis_run(&image->analysis, image->data, image->memory_size,
+                          chip8->mode)) {
+            return FALSE;
+        }
+
+        /* Failing to cache the analysis only costs time on the next
+         * launch. */
+        Cache_store(&image->analysis, rom, image->rom_size, chip8->mode);
+    }
+    image->analysed = TRUE;
+    chip8->analysis = &image->analysis;
+    return TRUE;
 }
 
-enum bool Chip8_turn_on(char *rom_file_name) {
-    FILE *interpreter_data, *rom;
+/* Release everything held for the loaded application, if any. */
+static void unload(struct Chip8 *chip8) {
+    if (!chip8->loaded) {
+        return;
+    }
 
-    /* The chip-8 requires some data intrinsic to the interpreter in memory
-     * before the ROM. */
-    interpreter_data = fopen(INTERPRETER_DATA_FILE_NAME, "rb");
-    if (!interpreter_data) {
-        fprintf(stderr, "The interpreter data could not be loaded. "
-                        "Ensure that the '%s' file is present in the "
-                        "working directory.\n", INTERPRETER_DATA_FILE_NAME);
+    free(chip8->dispatch);
+    chip8->dispatch = NULL;
+    Cpu_uninit(&chip8->cpu);
+    chip8->analysis = NULL;
+    Image_unmap_memory(chip8->image, chip8->memory);
+    Image_release(chip8->image);
+    chip8->image = NULL;
+    chip8->loaded = FALSE;
+}
+
+/* Power on the machine with a reference to an image. Return TRUE on success
+ * and FALSE on error, in which case the reference is released. */
+static enum bool power_on(struct Chip8 *chip8) {
+    /* Analyse the application up front so that the CPU can skip checks
+     * which are proven to pass, and pick up its quirks and speed. */
+    if (!analyse(chip8)) {
+        Image_release(chip8->image);
+        chip8->image = NULL;
         return FALSE;
     }
 
-    rom = fopen(rom_file_name, "rb");
-    if (!rom) {
-        fclose(interpreter_data);
-        fprintf(stderr, "The ROM file could not be loaded. "
-                        "Ensure that the '%s' file is present in the "
-                        "working directory.\n", rom_file_name);
+    /* Main memory is a private copy-on-write view of the image. */
+    chip8->memory = Image_map_memory(chip8->image);
+    if (!chip8->memory) {
+        chip8->analysis = NULL;
+        Image_release(chip8->image);
+        chip8->image = NULL;
         return FALSE;
     }
 
-    /* Allocate main memory for the system. */
-    memory = calloc(MEMORY_SIZE, sizeof *memory);
-    if (!memory) {
-        fclose(interpreter_data);
-        fclose(rom);
+    /* Reset the hardware modules. */
+    Screen_set_hires(&chip8->screen, FALSE);
+    Screen_select_planes(&chip8->screen, 1);
+    if (!Cpu_init(&chip8->cpu, chip8->memory, chip8->image->memory_size,
+                  chip8->mode, chip8->analysis->quirks,
+                  &chip8->screen, &chip8->input)) {
+        Image_unmap_memory(chip8->image, chip8->memory);
+        chip8->analysis = NULL;
+        Image_release(chip8->image);
+        chip8->image = NULL;
         return FALSE;
     }
+    Cpu_use_analysis(&chip8->cpu, chip8->analysis);
+
+    chip8->frame_cycles = 0;
+    chip8->cycle_count = 0;
+    if (chip8->audio) {
+        Sound_init(&chip8->sound, chip8->audio, &chip8->cpu);
+    }
+    chip8->loaded = TRUE;
+    return TRUE;
+}
+
+/* Generate the sound up to the current cycle of the frame if it has changed
+ * since the last time it was generated, so that it starts and stops at the
+ * sample it should whatever the frame's timing. */
+static void render_sound(struct Chip8 *chip8) {
+    const struct Cpu *cpu = &chip8->cpu;
+    struct Sound *sound = &chip8->sound;
+
+    if ((cpu->sound_timer > 0) != sound->playing
+        || cpu->pitch != sound->pitch) {
+        Sound_render(sound, cpu, chip8->frame_cycles * SAMPLES_PER_FRAME
+                                 / chip8->analysis->cycles_per_frame);
+    }
+}
+
+/* Write a bitmap of the chunks of the `size` bytes at `data` which differ
+ * from `reference` (or from zero if it is NULL) to `out`, followed by those
+ * chunks. Return the number of bytes written. */
+static size_t save_chunks(uint8_t *out, const uint8_t *data,
+                          const uint8_t *reference, size_t size) {
+    static const uint8_t ZERO[STATE_CHUNK_SIZE];
+    size_t chunk_count = size / STATE_CHUNK_SIZE;
+    size_t bitmap_size = (chunk_count + CHAR_BIT_COUNT - 1) / CHAR_BIT_COUNT;
+    size_t length = bitmap_size;
+    size_t i;
+
+    memset(out, 0, bitmap_size);
+    for (i = 0; i < chunk_count; i++) {
+        const uint8_t *chunk = data + i * STATE_CHUNK_SIZE;
+
+        if (memcmp(chunk, reference ? reference + i * STATE_CHUNK_SIZE : ZERO,
+                   STATE_CHUNK_SIZE) != 0) {
+            out[i / CHAR_BIT_COUNT] |= (uint8_t) (1u << i % CHAR_BIT_COUNT);
+            memcpy(out + length, chunk, STATE_CHUNK_SIZE);
+            length += STATE_CHUNK_SIZE;
+        }
+    }
+
+    return length;
+}
+
+/* Undo save_chunks, filling the `size` bytes at `data` from `in` and
+ * `reference`. Return the number of bytes read. */
+static size_t restore_chunks(uint8_t *data, const uint8_t *reference,
+                             const uint8_t *in, size_t size) {
+    size_t chunk_count = size / STATE_CHUNK_SIZE;
+    size_t bitmap_size = (chunk_count + CHAR_BIT_COUNT - 1) / CHAR_BIT_COUNT;
+    size_t length = bitmap_size;
+    size_t i;
+
+    for (i = 0; i < chunk_count; i++) {
+        uint8_t *chunk = data + i * STATE_CHUNK_SIZE;
+
+        if ((in[i / CHAR_BIT_COUNT] >> i % CHAR_BIT_COUNT) & 1u) {
+            memcpy(chunk, in + length, STATE_CHUNK_SIZE);
+            length += STATE_CHUNK_SIZE;
+        }
+        else if (reference) {
+            memcpy(chunk, reference + i * STATE_CHUNK_SIZE, STATE_CHUNK_SIZE);
+        }
+        else {
+            memset(chunk, 0, STATE_CHUNK_SIZE);
+        }
+    }
 
-    /* Load in the interpreter data which is constant
-     * regardless of the ROM. */
-    fread(memory, sizeof *memory, APPLICATION_START, interpreter_data);
-    fclose(interpreter_data);
+    return length;
+}
 
-    /* Load in the ROM. */
-    fread(memory + APPLICATION_START, sizeof *memory,
-          MEMORY_SIZE - APPLICATION_START, rom);
-    fclose(rom);
+/* Return the largest number of bytes save_chunks writes for `size`. */
+static size_t chunks_size(size_t size) {
+    size_t chunk_count = size / STATE_CHUNK_SIZE;
 
-    /* Initialize all hardware modules. */
-    if (!Screen_init()) {
-        free(memory);
+    return (chunk_count + CHAR_BIT_COUNT - 1) / CHAR_BIT_COUNT + size;
+}
+
+static uint32_t memory_size_of(enum Chip8_mode mode) {
+    return mode == MODE_XOCHIP ? XOCHIP_MEMORY_SIZE : MEMORY_SIZE;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Public Interface --------------------------------------------------------- */
+
+struct Chip8 *Chip8_create(enum Chip8_mode mode) {
+    struct Chip8 *chip8 = calloc(1, sizeof *chip8);
+
+    if (!chip8) {
+        return NULL;
+    }
+    chip8->mode = mode;
+
+    if (!Screen_init(&chip8->screen, mode)) {
+        free(chip8);
+        return NULL;
+    }
+    if (!Inp_init(&chip8->input)) {
+        Screen_uninit(&chip8->screen);
+        free(chip8);
+        return NULL;
+    }
+
+    return chip8;
+}
+
+enum bool Chip8_load_rom(struct Chip8 *chip8, const uint8_t *rom,
+                         size_t rom_size) {
+    unload(chip8);
+
+    chip8->image = Image_create(rom, rom_size, memory_size_of(chip8->mode));
+    if (!chip8->image) {
         return FALSE;
     }
-    if (!Inp_init()) {
-        Screen_uninit();
-        free(memory);
+    return power_on(chip8);
+}
+
+enum bool Chip8_load_rom_file(struct Chip8 *chip8, const char *rom_file_name) {
+    unload(chip8);
+
+    /* The ROM is mapped into the image rather than read. */
+    chip8->image = Image_open(rom_file_name, memory_size_of(chip8->mode));
+    if (!chip8->image) {
         return FALSE;
     }
-    if (!Cpu_init(memory)) {
-        Inp_uninit();
-        Screen_uninit();
-        free(memory);
+    return power_on(chip8);
+}
+
+enum bool Chip8_load_shared_rom(struct Chip8 *chip8,
+                                const struct Chip8 *source) {
+    struct Image *image;
+
+    if (!source->loaded || source->mode != chip8->mode) {
         return FALSE;
     }
 
-    /* Driving the system consists of continuously cycling the cpu and
-     * updating the screen. */
-    for (;;) {
-        enum bool draw = FALSE;
-        unsigned int i;
-
-        /* Run a number of CPU cycles at once. */
-        for (i = 0; i < 10; i++) {
-            enum bool invalidate_display;
-            if (!Cpu_cycle(&invalidate_display)) {
-                /* Invalid execution or bad CPU state, kill the emulator. */
-                Cpu_uninit();
-                Inp_uninit();
-                Screen_uninit();
-                free(memory);
-                return FALSE;
+    /* Take the reference first, as the source may be the machine itself. */
+    image = Image_share(source->image);
+    unload(chip8);
+    chip8->image = image;
+    return power_on(chip8);
+}
+
+enum bool Chip8_use_program(struct Chip8 *chip8,
+                            const struct Recompiled_program *program) {
+    const struct Image *image = chip8->image;
+    uint32_t i;
+
+    if (!chip8->loaded || program->mode != chip8->mode
+        || program->rom_size != image->rom_size
+        || memcmp(program->rom, image->data + APPLICATION_START,
+                  image->rom_size) != 0) {
+        return FALSE;
+    }
+
+    free(chip8->dispatch);
+    chip8->dispatch = calloc(image->memory_size, sizeof *chip8->dispatch);
+    if (!chip8->dispatch) {
+        return FALSE;
+    }
+    for (i = 0; i < program->block_count; i++) {
+        const struct Recompiled_block *block = &program->blocks[i];
+
+        if (block->address < image->memory_size) {
+            chip8->dispatch[block->address] = block;
+        }
+    }
+
+    return TRUE;
+}
+
+void Chip8_add_quirks(struct Chip8 *chip8, uint8_t quirks) {
+    chip8->cpu.quirks |= quirks;
+}
+
+void Chip8_seed(struct Chip8 *chip8, uint64_t seed) {
+    Cpu_seed(&chip8->cpu, seed);
+}
+
+void Chip8_set_audio(struct Chip8 *chip8, struct Ring *ring) {
+    chip8->audio = ring;
+    if (ring && chip8->loaded) {
+        Sound_init(&chip8->sound, ring, &chip8->cpu);
+    }
+}
+
+uint64_t Chip8_dropped_samples(const struct Chip8 *chip8) {
+    return chip8->audio && chip8->loaded ? chip8->sound.dropped_samples : 0;
+}
+
+enum bool Chip8_run_cycles(struct Chip8 *chip8, uint32_t cycles,
+                           enum bool *invalidate_display) {
+    uint32_t i;
+
+    *invalidate_display = FALSE;
+    if (!chip8->loaded) {
+        return FALSE;
+    }
+
+    for (i = 0; i < cycles && !Cpu_is_halted(&chip8->cpu);) {
+        uint16_t address = chip8->cpu.program_counter;
+        enum bool invalidate = FALSE;
+        int executed = 0;
+
+        /* Run a translated block where there is one. It stops at the end
+         * of the frame, so the timers tick at the same instruction as when
+         * the block is interpreted. */
+        if (chip8->dispatch && address < chip8->image->memory_size
+            && chip8->dispatch[address]) {
+            uint32_t budget = chip8->analysis->cycles_per_frame
+                              - chip8->frame_cycles;
+
+            if (budget > cycles - i) {
+                budget = cycles - i;
             }
+            executed = chip8->dispatch[address]->run(&chip8->cpu,
+                                                     (int) budget,
+                                                     &invalidate);
+        }
 
-            draw = draw || invalidate_display;
+        if (executed == 0) {
+            executed = Cpu_cycle(&chip8->cpu, &invalidate) ? 1 : -1;
         }
+        if (executed < 0) {
+            /* Invalid execution or bad CPU state. */
+            unload(chip8);
+            return FALSE;
+        }
+        *invalidate_display = *invalidate_display || invalidate;
+        i += (uint32_t) executed;
+        chip8->cycle_count += (uint64_t) executed;
 
-        if (draw) {
-            Port_clear_screen();
-            Screen_display();
+        /* The timers count down at 60hz, which is once a frame. */
+        chip8->frame_cycles += (uint32_t) executed;
+        if (chip8->frame_cycles >= chip8->analysis->cycles_per_frame) {
+            Cpu_tick_timers(&chip8->cpu);
+            chip8->frame_cycles = 0;
+            if (chip8->audio) {
+                Sound_end_frame(&chip8->sound, &chip8->cpu);
+            }
         }
+        else if (chip8->audio) {
+            render_sound(chip8);
+        }
+    }
 
-        Port_delay(DELAY_MS);
+    return TRUE;
+}
+
+enum bool Chip8_run_frame(struct Chip8 *chip8, enum bool *invalidate_display) {
+    if (!chip8->loaded) {
+        *invalidate_display = FALSE;
+        return FALSE;
     }
-    
-    /* We should never reach this because the chip8 can't be shut off. */
-    assert(0);
+
+    return Chip8_run_cycles(chip8, chip8->analysis->cycles_per_frame
+                                   - chip8->frame_cycles,
+                            invalidate_display);
+}
+
+uint64_t Chip8_cycle_count(const struct Chip8 *chip8) {
+    return chip8->loaded ? chip8->cycle_count : 0;
+}
+
+void Chip8_set_key(struct Chip8 *chip8, uint8_t key_number,
+                   enum bool pressed) {
+    Inp_set_key(&chip8->input, key_number, pressed);
+}
+
+enum bool Chip8_is_halted(const struct Chip8 *chip8) {
+    return chip8->loaded && Cpu_is_halted(&chip8->cpu) ? TRUE : FALSE;
+}
+
+const uint64_t *Chip8_framebuffer(const struct Chip8 *chip8,
+                                  uint16_t *width, uint16_t *height) {
+    return Screen_framebuffer(&chip8->screen, width, height);
+}
+
+size_t Chip8_state_size(const struct Chip8 *chip8) {
+    return sizeof(struct state_header)
+           + chunks_size(memory_size_of(chip8->mode))
+           + chunks_size(PLANE_COUNT * PLANE_WORD_COUNT * sizeof(uint64_t));
+}
+
+size_t Chip8_save_state(const struct Chip8 *chip8, uint8_t *buffer) {
+    struct state_header header;
+    size_t length = sizeof header;
+
+    assert(chip8->loaded);
+
+    /* Both memory sizes and the display are whole numbers of chunks. */
+    assert(PLANE_COUNT * PLANE_WORD_COUNT * sizeof(uint64_t)
+           % STATE_CHUNK_SIZE == 0);
+
+    memset(&header, 0, sizeof header);
+    header.cpu = chip8->cpu;
+    header.screen = chip8->screen;
+    header.input = chip8->input;
+    header.frame_cycles = chip8->frame_cycles;
+    memcpy(buffer, &header, sizeof header);
+
+    length += save_chunks(buffer + length, chip8->memory, chip8->image->data,
+                          chip8->image->memory_size);
+    length += save_chunks(buffer + length,
+                          (const uint8_t *) chip8->screen.display, NULL,
+                          PLANE_COUNT * PLANE_WORD_COUNT * sizeof(uint64_t));
+    return length;
+}
+
+void Chip8_restore_state(struct Chip8 *chip8, const uint8_t *buffer) {
+    struct state_header header;
+    uint64_t *display = chip8->screen.display;
+    size_t length = sizeof header;
+
+    assert(chip8->loaded);
+
+    memcpy(&header, buffer, sizeof header);
+    chip8->cpu = header.cpu;
+    chip8->cpu.memory = chip8->memory;
+    chip8->cpu.analysis = chip8->analysis;
+    chip8->cpu.screen = &chip8->screen;
+    chip8->cpu.input = &chip8->input;
+    chip8->screen = header.screen;
+    chip8->screen.display = display;
+    chip8->input = header.input;
+    chip8->frame_cycles = header.frame_cycles;
+
+    length += restore_chunks(chip8->memory, chip8->image->data,
+                             buffer + length, chip8->image->memory_size);
+    restore_chunks((uint8_t *) display, NULL, buffer + length,
+                   PLANE_COUNT * PLANE_WORD_COUNT * sizeof(uint64_t));
+}
+
+uint64_t Chip8_state_hash(const struct Chip8 *chip8) {
+    const struct Cpu *cpu = &chip8->cpu;
+    struct hashed_registers registers;
+    uint64_t hash;
+
+    memset(&registers, 0, sizeof registers);
+    registers.random_state = cpu->random_state;
+    memcpy(registers.stack, cpu->stack, sizeof registers.stack);
+    registers.program_counter = cpu->program_counter;
+    registers.I = cpu->I;
+    registers.stack_pointer = cpu->stack_pointer;
+    registers.delay_timer = cpu->delay_timer;
+    registers.sound_timer = cpu->sound_timer;
+    registers.width = chip8->screen.width;
+    registers.held_keys = chip8->input.held_keys;
+    registers.pressed_keys = chip8->input.pressed_keys;
+    memcpy(registers.register_v, cpu->register_v,
+           sizeof registers.register_v);
+    memcpy(registers.flag_registers, cpu->flag_registers,
+           sizeof registers.flag_registers);
+    memcpy(registers.audio_pattern, cpu->audio_pattern,
+           sizeof registers.audio_pattern);
+    registers.pitch = cpu->pitch;
+    registers.selected_planes = chip8->screen.selected_planes;
+    registers.waiting_for_key = (uint8_t) cpu->waiting_for_key;
+    registers.halted = (uint8_t) cpu->halted;
+
+    hash = Hash_xxh64(&registers, sizeof registers, chip8->frame_cycles);
+    hash = Hash_xxh64(chip8->screen.display,
+                      PLANE_COUNT * PLANE_WORD_COUNT * sizeof(uint64_t),
+                      hash);
+    return Hash_xxh64(chip8->memory, chip8->image->memory_size, hash);
+}
+
+void Chip8_print_analysis(const struct Chip8 *chip8, FILE *out) {
+    assert(chip8->loaded);
+
+    Analysis_print(chip8->analysis, out);
+}
+
+void Chip8_destroy(struct Chip8 *chip8) {
+    if (!chip8) {
+        return;
+    }
+
+    unload(chip8);
+    Inp_uninit(&chip8->input);
+    Screen_uninit(&chip8->screen);
+    free(chip8);
 }
@@ -6,23 +6,76 @@
 
 const uint8_t CHAR_BIT_COUNT = 8;
 
+const uint8_t WORD_BIT_COUNT = 64;
+
 const uint16_t MEMORY_SIZE = 4 * 1024;
 
+const uint32_t XOCHIP_MEMORY_SIZE = 64 * 1024;
+
 const uint8_t STACK_SIZE = 8;
 
+const uint8_t SCHIP_STACK_SIZE = 16;
+
+const uint8_t FLAG_REGISTER_COUNT = 16;
+
 const uint16_t APPLICATION_START = 0x200;
 
-const char *INTERPRETER_DATA_FILE_NAME = "interpreter";
+const uint8_t DIGIT_SPRITE_DATA[] = {
+    0xF0, 0x90, 0x90, 0x90, 0xF0, /* 0 */
+    0x20, 0x60, 0x20, 0x20, 0x70, /* 1 */
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, /* 2 */
+    0xF0, 0x10, 0xF0, 0x10, 0xF0, /* 3 */
+    0x90, 0x90, 0xF0, 0x10, 0x10, /* 4 */
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, /* 5 */
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, /* 6 */
+    0xF0, 0x10, 0x20, 0x40, 0x40, /* 7 */
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, /* 8 */
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, /* 9 */
+    0xF0, 0x90, 0xF0, 0x90, 0x90, /* A */
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, /* B */
+    0xF0, 0x80, 0x80, 0x80, 0xF0, /* C */
+    0xE0, 0x90, 0x90, 0x90, 0xE0, /* D */
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, /* E */
+    0xF0, 0x80, 0xF0, 0x80, 0x80  /* F */
+};
+
+const uint8_t DIGIT_SPRITE_SIZE = 5;
 
 const uint16_t DIGIT_SPRITE_LOCATION[] = {0x00, 0x05, 0x0A, 0x0F,
                                           0x14, 0x19, 0x1E, 0x23,
                                           0x28, 0x2D, 0x32, 0x37,
                                           0x3C, 0x41, 0x46, 0x4B};
 
-const uint16_t CYCLES_PER_SECOND = 500;
+const uint8_t BIG_DIGIT_SPRITE_DATA[] = {
+    0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, /* 0 */
+    0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, /* 1 */
+    0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, /* 2 */
+    0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, /* 3 */
+    0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, /* 4 */
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, /* 5 */
+    0x3E, 0x7C, 0xC0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, /* 6 */
+    0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, /* 7 */
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, /* 8 */
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C  /* 9 */
+};
+
+const uint16_t BIG_DIGIT_SPRITE_LOCATION[] = {0x50, 0x5A, 0x64, 0x6E, 0x78,
+                                              0x82, 0x8C, 0x96, 0xA0, 0xAA};
+
+const uint8_t BIG_DIGIT_SPRITE_SIZE = 10;
+
+const uint16_t CYCLES_PER_SECOND = 600;
 
 const uint16_t CYCLES_PER_DELAY = 10;
 
+const uint32_t SAMPLE_RATE = 48000;
+
 const uint16_t WIDTH_PIXEL_COUNT = 64;
 
 const uint16_t HEIGHT_PIXEL_COUNT = 32;
+
+const uint16_t HIRES_WIDTH_PIXEL_COUNT = 128;
+
+const uint16_t HIRES_HEIGHT_PIXEL_COUNT = 64;
+
+const uint8_t PLANE_COUNT = 2;
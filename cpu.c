@@ -11,102 +11,132 @@
 #include "input.h"
 #include "constant.h"
 
-/* Pointer to the system memory. */
-static uint8_t *memory;
-
-/* Counts down at 60hz if above 0. */
-static int16_t delay_timer;
-
-/* Counts down at 60hz and emits a tone if above 0. */
-static int16_t sound_timer;
-
-/* -------------------------------------------------------------------------- */
-/* CPU Managed Registers ---------------------------------------------------- */
-
-/* Points to the memory address currently being executed. */
-static uint16_t program_counter;
-
-/* Stores return addresses for subroutine calls. */
-static uint16_t *stack;
-
-/* Points to the top of the stack, the next place that a return address will
- * be placed. */
-static int16_t stack_pointer;
-
-/* -------------------------------------------------------------------------- */
-/* Application Managed Registers -------------------------------------------- */
-
-/* The CPU's 16 main registers, V0-VF. */
-static uint8_t *register_v;
-
 /* The last register, VF, is used as a carry/overflow indicator. */
 static const int F = 0xF;
 
-/* An additional register I is often used by the application to hold a memory address. */
-static uint16_t I;
+/* Largest sprite that DXYN may draw in bytes: 16x16 on two bitplanes. */
+#define MAX_SPRITE_SIZE 64
 
 /* -------------------------------------------------------------------------- */
 /* Private Interface -------------------------------------------------------- */
 
 /* Abort the program if the CPU is in an invalid state. */
-static void check_invariants(void) {
+static void check_invariants(const struct Cpu *cpu) {
     /* Program counter points to two bytes at once, aligned at an even
      * address. We may not execute in the interpreter data. */
-    assert(program_counter % 2 == 0);
-    assert(program_counter >= APPLICATION_START);
-    assert(program_counter < MEMORY_SIZE);
+    assert(cpu->program_counter % 2 == 0);
+    assert(cpu->program_counter >= APPLICATION_START);
+    assert(cpu->program_counter < cpu->memory_size);
 
     /* Stack pointer increments after a push, so it may point to one past
      * the end of the stack if the stack is full. */
-    assert(stack_pointer >= 0);
-    assert(stack_pointer <= STACK_SIZE);
+    assert(cpu->stack_pointer >= 0);
+    assert(cpu->stack_pointer <= cpu->stack_size);
 
     /* Timers count down until zero, then deactivate. */
-    assert(delay_timer >= 0);
-    assert(sound_timer >= 0);
+    assert(cpu->delay_timer >= 0);
+    assert(cpu->sound_timer >= 0);
 }
 
-enum bool Cpu_init(uint8_t *allocated_memory) {
-    memory = allocated_memory;
+/* Return TRUE iff. the analysis proves that the invariants hold, and that
+ * every access through I stays within memory, at the current instruction. */
+static enum bool is_proven(const struct Cpu *cpu) {
+    return cpu->analysis
+           && Analysis_is_proven(cpu->analysis, cpu->program_counter)
+           ? TRUE : FALSE;
+}
 
-    delay_timer = 0;
-    sound_timer = 0;
+/* Return the address `offset` bytes past I. Accesses through I wrap around
+ * the end of memory, which only needs doing where they are not `proven` to
+ * stay inside it. */
+static uint32_t address_at_i(const struct Cpu *cpu, enum bool proven,
+                             uint32_t offset) {
+    uint32_t address = cpu->I + offset;
 
-    /* Recall that the ROM is loaded in at APPLICATION_START,
-     * not at address 0 (which is used by the interpreter). */
-    program_counter = APPLICATION_START;
+    return proven ? address : address % cpu->memory_size;
+}
 
-    /* Allocate the registers and clear them. */
-    I = 0;
-    register_v = calloc(0xF, sizeof *register_v);
-    if (!register_v) {
-        return FALSE;
+/* Return the size in bytes of the instruction at `address`. Only the XO-CHIP
+ * F000 NNNN instruction is longer than two bytes, and skip instructions must
+ * jump over all of it. */
+static uint16_t instruction_size(const struct Cpu *cpu, uint16_t address) {
+    if (cpu->mode == MODE_XOCHIP && address + 1u < cpu->memory_size
+        && cpu->memory[address] == 0xF0 && cpu->memory[address + 1] == 0x00) {
+        return 4;
     }
+    return 2;
+}
 
-    /* Allocate the stack and point to the top of it. */
-    stack_pointer = 0;
-    stack = malloc(STACK_SIZE * sizeof *stack);
-    if (!stack) {
-        free(register_v);
-        return FALSE;
-    }
+/* Move the program counter past the instruction following the current one. */
+static void skip_next_instruction(struct Cpu *cpu) {
+    cpu->program_counter += instruction_size(cpu, cpu->program_counter + 2);
+}
+
+/* Return the next pseudorandom number (xorshift64*). */
+static uint64_t next_random(struct Cpu *cpu) {
+    cpu->random_state ^= cpu->random_state >> 12;
+    cpu->random_state ^= cpu->random_state << 25;
+    cpu->random_state ^= cpu->random_state >> 27;
+    return cpu->random_state * 0x2545F4914F6CDD1DULL;
+}
+
+enum bool Cpu_init(struct Cpu *cpu, uint8_t *memory, uint32_t memory_size,
+                   enum Chip8_mode mode, uint8_t quirks,
+                   struct Screen *screen, struct Input *input) {
+    memset(cpu, 0, sizeof *cpu);
+
+    cpu->memory = memory;
+    cpu->memory_size = memory_size;
+    cpu->mode = mode;
+    cpu->quirks = quirks;
+    cpu->screen = screen;
+    cpu->input = input;
+    /* Until an XO-CHIP application loads a pattern of its own, the buzzer
+     * plays a square wave, of 500hz at the default pitch. */
+    memset(cpu->audio_pattern, 0xF0, sizeof cpu->audio_pattern);
+    cpu->pitch = 64;
+
+    /* Recall that the ROM is loaded in at APPLICATION_START,
+     * not at address 0 (which is used by the interpreter). */
+    cpu->program_counter = APPLICATION_START;
+
+    /* The registers are clear and the stack pointer points to the top of
+     * the stack. */
+    cpu->stack_size = mode == MODE_CHIP8 ? STACK_SIZE : SCHIP_STACK_SIZE;
 
     /* Seed the RNG. */
-    srand((unsigned int) time(NULL));
-    
-    check_invariants();
+    Cpu_seed(cpu, (uint64_t) time(NULL) ^ (uintptr_t) cpu);
+
+    check_invariants(cpu);
     return TRUE;
 }
 
-enum bool Cpu_cycle(enum bool *invalidate_display) {
-    check_invariants();
+void Cpu_seed(struct Cpu *cpu, uint64_t seed) {
+    /* The generator must never be in the all zero state. */
+    cpu->random_state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+}
+
+void Cpu_use_analysis(struct Cpu *cpu, const struct Analysis *analysis) {
+    cpu->analysis = analysis;
+}
+
+enum bool Cpu_cycle(struct Cpu *cpu, enum bool *invalidate_display) {
+    /* Whether the analysis proves the current instruction safe. */
+    enum bool proven = is_proven(cpu);
+
+    if (!proven) {
+        check_invariants(cpu);
+    }
+
+    /* The main registers, as named by the opcodes. */
+    uint8_t *V = cpu->register_v;
 
     /* Set when an opcode cannot be successfully decoded. */
     enum bool unknown_opcode = FALSE;
 
     /* Fetch current two byte instruction. */
-    uint8_t first_byte = memory[program_counter];
-    uint8_t second_byte = memory[program_counter + 1];
+    uint8_t first_byte = cpu->memory[cpu->program_counter];
+    uint8_t second_byte = cpu->memory[cpu->program_counter + 1];
     uint16_t opcode = first_byte << 8u | second_byte;
 
     uint8_t first_nibble = (opcode >> 12) & 0x0F;
@@ -122,15 +152,55 @@ enum bool Cpu_cycle(enum bool *invalidate_display) {
         case 0x0:
             if ((opcode & 0x0FFFu) == 0x0E0) {
                 /* 00E0: Clear the screen. */
-                Screen_clear();
+                Screen_clear(cpu->screen);
                 *invalidate_display = TRUE;
-                program_counter += 2;
+                cpu->program_counter += 2;
             }
             else if ((opcode & 0x0FFFu) == 0x0EE) {
                 /* 00EE: Return from subroutine. */
-                stack_pointer--;
-                program_counter = stack[stack_pointer];
-                program_counter += 2;
+                if (cpu->stack_pointer <= 0) {
+                    fprintf(stderr, "Stack underflow at %03x\n",
+                            cpu->program_counter);
+                    return FALSE;
+                }
+                cpu->stack_pointer--;
+                cpu->program_counter = cpu->stack[cpu->stack_pointer];
+                cpu->program_counter += 2;
+            }
+            else if ((opcode & 0x0FF0u) == 0x0C0 && cpu->mode >= MODE_SCHIP) {
+                /* 00CN: Scroll the display down N pixels. */
+                Screen_scroll_down(cpu->screen, fourth_nibble);
+                *invalidate_display = TRUE;
+                cpu->program_counter += 2;
+            }
+            else if ((opcode & 0x0FF0u) == 0x0D0 && cpu->mode == MODE_XOCHIP) {
+                /* 00DN: Scroll the display up N pixels. */
+                Screen_scroll_up(cpu->screen, fourth_nibble);
+                *invalidate_display = TRUE;
+                cpu->program_counter += 2;
+            }
+            else if ((opcode & 0x0FFFu) == 0x0FB && cpu->mode >= MODE_SCHIP) {
+                /* 00FB: Scroll the display right 4 pixels. */
+                Screen_scroll_right(cpu->screen, 4);
+                *invalidate_display = TRUE;
+                cpu->program_counter += 2;
+            }
+            else if ((opcode & 0x0FFFu) == 0x0FC && cpu->mode >= MODE_SCHIP) {
+                /* 00FC: Scroll the display left 4 pixels. */
+                Screen_scroll_left(cpu->screen, 4);
+                *invalidate_display = TRUE;
+                cpu->program_counter += 2;
+            }
+            else if ((opcode & 0x0FFFu) == 0x0FD && cpu->mode >= MODE_SCHIP) {
+                /* 00FD: Exit the interpreter. */
+                cpu->halted = TRUE;
+                cpu->program_counter += 2;
+            }
+            else if ((opcode & 0x0FFEu) == 0x0FE && cpu->mode >= MODE_SCHIP) {
+                /* 00FE, 00FF: Switch to low or high resolution. */
+                Screen_set_hires(cpu->screen, opcode & 1u ? TRUE : FALSE);
+                *invalidate_display = TRUE;
+                cpu->program_counter += 2;
             }
             else {
                 unknown_opcode = TRUE;
@@ -139,39 +209,67 @@ enum bool Cpu_cycle(enum bool *invalidate_display) {
 
         case 0x1:
             /* 1NNN: Goto address NNN. */
-            program_counter = opcode & 0x0FFF;
+            cpu->program_counter = opcode & 0x0FFF;
             break;
 
         case 0x2:
             /* 2NNN: Call address NNN. */
-            stack[stack_pointer] = program_counter;
-            stack_pointer++;
-            program_counter = opcode & 0x0FFF;
+            if (cpu->stack_pointer >= cpu->stack_size) {
+                fprintf(stderr, "Stack overflow at %03x\n",
+                        cpu->program_counter);
+                return FALSE;
+            }
+            cpu->stack[cpu->stack_pointer] = cpu->program_counter;
+            cpu->stack_pointer++;
+            cpu->program_counter = opcode & 0x0FFF;
             break;
 
         case 0x3:
             /* 3XNN: Skip next instruction if VX == NN. */
-            if (register_v[second_nibble] == second_byte) {
-                program_counter += 2;
+            if (V[second_nibble] == second_byte) {
+                skip_next_instruction(cpu);
             }
-            program_counter += 2;
+            cpu->program_counter += 2;
             break;
 
         case 0x4:
             /* 4XNN: Skip next instruction if VX != NN. */
-            if (register_v[second_nibble] != second_byte) {
-                program_counter += 2;
+            if (V[second_nibble] != second_byte) {
+                skip_next_instruction(cpu);
             }
-            program_counter += 2;
+            cpu->program_counter += 2;
             break;
 
         case 0x5:
             if (fourth_nibble == 0) {
                 /* 5XY0: Skip next instruction if VX == VY. */
-                if (register_v[second_nibble] == register_v[third_nibble]) {
-                    program_counter += 2;
+                if (V[second_nibble] == V[third_nibble]) {
+                    skip_next_instruction(cpu);
+                }
+                cpu->program_counter += 2;
+            }
+            else if ((fourth_nibble == 2 || fourth_nibble == 3)
+                     && cpu->mode == MODE_XOCHIP) {
+                /* 5XY2, 5XY3: Save or load VX through VY (in either order)
+                 * to or from memory starting at I, leaving I unchanged. */
+                int step = second_nibble <= third_nibble ? 1 : -1;
+                uint8_t r = second_nibble;
+                uint32_t offset = 0;
+
+                for (;; r += step, offset++) {
+                    uint32_t address = address_at_i(cpu, proven, offset);
+
+                    if (fourth_nibble == 2) {
+                        cpu->memory[address] = V[r];
+                    }
+                    else {
+                        V[r] = cpu->memory[address];
+                    }
+                    if (r == third_nibble) {
+                        break;
+                    }
                 }
-                program_counter += 2;
+                cpu->program_counter += 2;
             }
             else {
                 unknown_opcode = TRUE;
@@ -180,92 +278,86 @@ enum bool Cpu_cycle(enum bool *invalidate_display) {
 
         case 0x6:
             /* 6XNN: VX = NN. */
-            register_v[second_nibble] = second_byte;
-            program_counter += 2;
+            V[second_nibble] = second_byte;
+            cpu->program_counter += 2;
             break;
 
         case 0x7:
             /* 7XNN: VX += NN. */
-            register_v[second_nibble] += second_byte;
-            program_counter += 2;
+            V[second_nibble] += second_byte;
+            cpu->program_counter += 2;
             break;
 
         case 0x8:
             switch (fourth_nibble) {
                 case 0x0:
                     /* 8XY0: VX = VY. */
-                    register_v[second_nibble] = register_v[third_nibble];
-                    program_counter += 2;
+                    V[second_nibble] = V[third_nibble];
+                    cpu->program_counter += 2;
                     break;
 
                 case 0x1:
                     /* 8XY1: VX |= VY. */
-                    register_v[second_nibble] |= register_v[third_nibble];
-                    program_counter += 2;
+                    V[second_nibble] |= V[third_nibble];
+                    cpu->program_counter += 2;
                     break;
 
                 case 0x2:
                     /* 8XY2: VX &= VY. */
-                    register_v[second_nibble] &= register_v[third_nibble];
-                    program_counter += 2;
+                    V[second_nibble] &= V[third_nibble];
+                    cpu->program_counter += 2;
                     break;
 
                 case 0x3:
                     /* 8XY3: VX ^= VY. */
-                    register_v[second_nibble] ^= register_v[third_nibble];
-                    program_counter += 2;
+                    V[second_nibble] ^= V[third_nibble];
+                    cpu->program_counter += 2;
                     break;
 
                 case 0x4:
                     /* 8XY4: VX += VY. */
-                    register_v[second_nibble] += register_v[third_nibble];
-                    register_v[F] =
-                        register_v[second_nibble] < register_v[third_nibble];
-                    program_counter += 2;
+                    V[second_nibble] += V[third_nibble];
+                    V[F] = V[second_nibble] < V[third_nibble];
+                    cpu->program_counter += 2;
                     break;
 
                 case 0x5:
                     /* 8XY5: VX -= VY. */
-                    register_v[F] =
-                        register_v[second_nibble] > register_v[third_nibble];
-                    register_v[second_nibble] -= register_v[third_nibble];
-                    program_counter += 2;
+                    V[F] = V[second_nibble] > V[third_nibble];
+                    V[second_nibble] -= V[third_nibble];
+                    cpu->program_counter += 2;
                     break;
 
                 case 0x6:
                     /* 8XY6: VX >>= 1. */
-                    /* Specs on this operation differ; this assertion ensures
-                     * that application writers do not assume functionality
-                     * unsupported by this emulator.
-                     * This assertion has never failed in my testing of CHIP-8
-                     * ROMS available online. */
-                    assert(second_nibble == third_nibble);
-                    register_v[F] = register_v[second_nibble] & 1;
-                    register_v[second_nibble] >>= 1;
-                    program_counter += 2;
+                    /* Specs on this operation differ; the original
+                     * interpreter shifted VY into VX, which the analysis
+                     * detects from applications that name two registers. */
+                    if (cpu->quirks & QUIRK_SHIFT_FROM_VY) {
+                        V[second_nibble] = V[third_nibble];
+                    }
+                    V[F] = V[second_nibble] & 1;
+                    V[second_nibble] >>= 1;
+                    cpu->program_counter += 2;
                     break;
 
                 case 0x7:
                     /* 8XY7: VX = VY - VX. */
-                    register_v[F] =
-                        register_v[third_nibble] > register_v[second_nibble];
-                    register_v[second_nibble] =
-                        register_v[third_nibble] - register_v[second_nibble];
-                    program_counter += 2;
+                    V[F] = V[third_nibble] > V[second_nibble];
+                    V[second_nibble] = V[third_nibble] - V[second_nibble];
+                    cpu->program_counter += 2;
                     break;
 
                 case 0xE:
                     /* 8XYE: VX <<= 1. */
-                    /* Specs on this operation differ; this assertion ensures
-                     * that application writers do not assume
-                     * functionality unsupported by this emulator.
-                     * This assertion has never failed in my testing of CHIP-8
-                     * ROMS available online. */
-                    assert(second_nibble == third_nibble);
-                    register_v[F] = (register_v[second_nibble]
-                                     & (1u << (CHAR_BIT_COUNT - 1))) != 0;
-                    register_v[second_nibble] <<= 1;
-                    program_counter += 2;
+                    /* See 8XY6 above. */
+                    if (cpu->quirks & QUIRK_SHIFT_FROM_VY) {
+                        V[second_nibble] = V[third_nibble];
+                    }
+                    V[F] = (V[second_nibble]
+                            & (1u << (CHAR_BIT_COUNT - 1))) != 0;
+                    V[second_nibble] <<= 1;
+                    cpu->program_counter += 2;
                     break;
 
                 default:
@@ -278,10 +370,10 @@ enum bool Cpu_cycle(enum bool *invalidate_display) {
             if (fourth_nibble == 0) {
                 /* 9XY0: Skip next instruction if VX != VY. */
                 assert(fourth_nibble == 0);
-                if (register_v[second_nibble] != register_v[third_nibble]) {
-                    program_counter += 2;
+                if (V[second_nibble] != V[third_nibble]) {
+                    skip_next_instruction(cpu);
                 }
-                program_counter += 2;
+                cpu->program_counter += 2;
             }
             else {
                 unknown_opcode = TRUE;
@@ -290,62 +382,81 @@ enum bool Cpu_cycle(enum bool *invalidate_display) {
 
         case 0xA:
             /* ANNN: I = NNN. */
-            I = opcode & 0x0FFF;
-            program_counter += 2;
+            cpu->I = opcode & 0x0FFF;
+            cpu->program_counter += 2;
             break;
 
         case 0xB:
-            /* BNNN: goto V0 + NNN. */
-            program_counter = register_v[0] + (opcode & 0x0FFF);
+            if (cpu->quirks & QUIRK_JUMP_VX) {
+                /* BXNN: goto VX + XNN. */
+                cpu->program_counter = V[second_nibble] + (opcode & 0x0FFF);
+            }
+            else {
+                /* BNNN: goto V0 + NNN. */
+                cpu->program_counter = V[0] + (opcode & 0x0FFF);
+            }
             break;
 
         case 0xC:
             /* CXNN: VX = random byte & NN. */
-            /* TODO: Uniform randomness. */
-            register_v[second_nibble] = (rand() % 256) & second_byte;
-            program_counter += 2;
+            V[second_nibble] = (next_random(cpu) >> 56) & second_byte;
+            cpu->program_counter += 2;
             break;
 
         case 0xD: {
             /* DXYN: Draw sprite at (x,y)=(VX,VY), (width,height)=(8,N).
-             * V[F] is set if collision, otherwise cleared. */
-            unsigned int i, j;
-            uint16_t bitstring_location;
-            uint8_t sprite_row;
-
-            register_v[F] = 0;
-            bitstring_location = I;
-            for (i = 0; i < fourth_nibble; i++) {
-                sprite_row = memory[bitstring_location];
-                for (j = 0; j < 8; j++) {
-                    if (Screen_paint(register_v[second_nibble] + j,
-                                     register_v[third_nibble] + i,
-                                     (sprite_row >> 7) & 1)) {
-                        register_v[F] = 1;
-                    }
-                    sprite_row <<= 1;
-                }
-                bitstring_location++;
+             * DXY0 draws a 16x16 sprite on SUPER-CHIP and XO-CHIP.
+             * V[F] is set if collision, otherwise cleared. In SUPER-CHIP high
+             * resolution it holds the number of rows that collided. */
+            uint8_t sprite[MAX_SPRITE_SIZE];
+            uint8_t width = 8, height = fourth_nibble;
+            uint8_t collided_rows;
+            unsigned int size, i;
+
+            if (height == 0 && cpu->mode >= MODE_SCHIP) {
+                width = 16;
+                height = 16;
+            }
+
+            /* Gather the sprite data for every bitplane that can be
+             * selected: only XO-CHIP can draw on the second. */
+            size = height * width / CHAR_BIT_COUNT;
+            if (cpu->mode == MODE_XOCHIP) {
+                size *= PLANE_COUNT;
+            }
+            for (i = 0; i < size; i++) {
+                sprite[i] = cpu->memory[address_at_i(cpu, proven, i)];
+            }
+
+            collided_rows = Screen_draw_sprite(cpu->screen,
+                                               V[second_nibble],
+                                               V[third_nibble],
+                                               sprite, width, height);
+            if (cpu->mode == MODE_SCHIP && Screen_is_hires(cpu->screen)) {
+                V[F] = collided_rows;
+            }
+            else {
+                V[F] = collided_rows ? 1 : 0;
             }
             *invalidate_display = TRUE;
-            program_counter += 2;
+            cpu->program_counter += 2;
             break;
         }
 
         case 0xE:
             if (second_byte == 0x9E) {
                 /* EX9E: skip if VX key is pressed. */
-                if (Inp_is_pressed(register_v[second_nibble])) {
-                    program_counter += 2;
+                if (Inp_is_pressed(cpu->input, V[second_nibble])) {
+                    skip_next_instruction(cpu);
                 }
-                program_counter += 2;
+                cpu->program_counter += 2;
             }
             else if (third_nibble == 0xA) {
                 /* EXA1: skip if VX key isn't pressed. */
-                if (!Inp_is_pressed(register_v[second_nibble])) {
-                    program_counter += 2;
+                if (!Inp_is_pressed(cpu->input, V[second_nibble])) {
+                    skip_next_instruction(cpu);
                 }
-                program_counter += 2;
+                cpu->program_counter += 2;
             }
             else {
                 unknown_opcode = TRUE;
@@ -354,68 +465,177 @@ enum bool Cpu_cycle(enum bool *invalidate_display) {
 
         case 0xF:
             switch (second_byte) {
+                case 0x00:
+                    /* F000 NNNN: I = NNNN. */
+                    if (second_nibble != 0 || cpu->mode != MODE_XOCHIP) {
+                        unknown_opcode = TRUE;
+                        break;
+                    }
+                    cpu->I = cpu->memory[(cpu->program_counter + 2)
+                                         % cpu->memory_size] << 8u
+                             | cpu->memory[(cpu->program_counter + 3)
+                                           % cpu->memory_size];
+                    cpu->program_counter += 4;
+                    break;
+
+                case 0x01:
+                    /* FN01: Select bitplanes N for drawing. */
+                    if (cpu->mode != MODE_XOCHIP) {
+                        unknown_opcode = TRUE;
+                        break;
+                    }
+                    Screen_select_planes(cpu->screen, second_nibble);
+                    cpu->program_counter += 2;
+                    break;
+
+                case 0x02: {
+                    /* F002: Load the 16 byte audio pattern from I. */
+                    unsigned int i;
+
+                    if (second_nibble != 0 || cpu->mode != MODE_XOCHIP) {
+                        unknown_opcode = TRUE;
+                        break;
+                    }
+                    for (i = 0; i < sizeof cpu->audio_pattern; i++) {
+                        cpu->audio_pattern[i] =
+                            cpu->memory[address_at_i(cpu, proven, i)];
+                    }
+                    cpu->program_counter += 2;
+                    break;
+                }
+
                 case 0x07:
                     /* FX07: VX = delay timer. */
-                    register_v[second_nibble] = delay_timer;
-                    program_counter += 2;
+                    V[second_nibble] = cpu->delay_timer;
+                    cpu->program_counter += 2;
                     break;
 
-                case 0x0A:
-                    /* FX0A: VX = next key pressed (block until input). */
-                    register_v[second_nibble] = Inp_blocking_next();
-                    program_counter += 2;
+                case 0x0A: {
+                    /* FX0A: VX = next key pressed (block until input). The
+                     * instruction is repeated until a key is pressed so that
+                     * the host keeps control while the CPU blocks. */
+                    uint8_t key;
+
+                    if (!cpu->waiting_for_key) {
+                        Inp_clear_presses(cpu->input);
+                        cpu->waiting_for_key = TRUE;
+                    }
+                    if (Inp_next_press(cpu->input, &key)) {
+                        V[second_nibble] = key;
+                        cpu->waiting_for_key = FALSE;
+                        cpu->program_counter += 2;
+                    }
                     break;
+                }
 
                 case 0x15:
                     /* FX15: delay timer = VX. */
-                    delay_timer = register_v[second_nibble];
-                    program_counter += 2;
+                    cpu->delay_timer = V[second_nibble];
+                    cpu->program_counter += 2;
                     break;
 
                 case 0x18:
                     /* FX18: sound timer = VX. */
-                    sound_timer = register_v[second_nibble];
-                    program_counter += 2;
+                    cpu->sound_timer = V[second_nibble];
+                    cpu->program_counter += 2;
                     break;
 
                 case 0x1E:
                     /* FX1E: I += VX. */
-                    I += register_v[second_nibble];
-                    program_counter += 2;
+                    cpu->I += V[second_nibble];
+                    cpu->program_counter += 2;
                     break;
 
                 case 0x29:
-                    /* FX29: I = address of sprite specified by VX. */
-                    assert(register_v[second_nibble] <= 0xF);
-                    I = DIGIT_SPRITE_LOCATION[register_v[second_nibble]];
-                    program_counter += 2;
+                    /* FX29: I = address of sprite specified by VX. Only
+                     * the low digit counts, as on the original
+                     * interpreter. */
+                    cpu->I = DIGIT_SPRITE_LOCATION[V[second_nibble] & 0xF];
+                    cpu->program_counter += 2;
+                    break;
+
+                case 0x30:
+                    /* FX30: I = address of 8x10 sprite specified by VX. */
+                    /* There are only big sprites for the decimal digits. */
+                    if (cpu->mode < MODE_SCHIP || V[second_nibble] > 9) {
+                        unknown_opcode = TRUE;
+                        break;
+                    }
+                    cpu->I = BIG_DIGIT_SPRITE_LOCATION[V[second_nibble]];
+                    cpu->program_counter += 2;
+                    break;
+
+                case 0x3A:
+                    /* FX3A: audio pitch = VX. */
+                    if (cpu->mode != MODE_XOCHIP) {
+                        unknown_opcode = TRUE;
+                        break;
+                    }
+                    cpu->pitch = V[second_nibble];
+                    cpu->program_counter += 2;
                     break;
 
                 case 0x33: {
                     /* FX33: store the decimal representation of value at
-                     * VX (hundreds, tens, units) in I, I+1, I+2. */
-                    uint8_t decimal_value = register_v[second_nibble];
-                    memory[I] = decimal_value / 100;
+                     * VX (hundreds, tens, units) in I, I+1, I+2, wrapping
+                     * around the end of memory. */
+                    uint8_t decimal_value = V[second_nibble];
+
+                    cpu->memory[address_at_i(cpu, proven, 0)] =
+                        decimal_value / 100;
                     decimal_value %= 100;
-                    memory[I + 1] = decimal_value / 10;
+                    cpu->memory[address_at_i(cpu, proven, 1)] =
+                        decimal_value / 10;
                     decimal_value %= 10;
-                    memory[I + 2] = decimal_value;
-                    program_counter += 2;
+                    cpu->memory[address_at_i(cpu, proven, 2)] = decimal_value;
+                    cpu->program_counter += 2;
+                    break;
+                }
+
+                case 0x55: {
+                    /* FX55: store V0 through VX in memory starting at I,
+                     * wrapping around the end of memory. */
+                    unsigned int i;
+
+                    for (i = 0; i <= second_nibble; i++) {
+                        cpu->memory[address_at_i(cpu, proven, i)] = V[i];
+                    }
+                    cpu->program_counter += 2;
                     break;
                 }
 
-                case 0x55:
-                    /* FX55: store V0 through VX in memory starting at I. */
-                    assert(second_nibble <= 0xF);
-                    memcpy(memory + I, register_v, second_nibble + 1);
-                    program_counter += 2;
+                case 0x65: {
+                    /* FX65: load V0 through VX from memory starting at I,
+                     * wrapping around the end of memory. */
+                    unsigned int i;
+
+                    for (i = 0; i <= second_nibble; i++) {
+                        V[i] = cpu->memory[address_at_i(cpu, proven, i)];
+                    }
+                    cpu->program_counter += 2;
+                    break;
+                }
+
+                case 0x75:
+                    /* FX75: store V0 through VX in the flag registers. */
+                    if (cpu->mode < MODE_SCHIP) {
+                        unknown_opcode = TRUE;
+                        break;
+                    }
+                    assert(second_nibble < FLAG_REGISTER_COUNT);
+                    memcpy(cpu->flag_registers, V, second_nibble + 1);
+                    cpu->program_counter += 2;
                     break;
 
-                case 0x65:
-                    /* FX65: load V0 through VX from memory starting at I. */
-                    assert(second_nibble <= 0xF);
-                    memcpy(register_v, memory + I, second_nibble + 1);
-                    program_counter += 2;
+                case 0x85:
+                    /* FX85: load V0 through VX from the flag registers. */
+                    if (cpu->mode < MODE_SCHIP) {
+                        unknown_opcode = TRUE;
+                        break;
+                    }
+                    assert(second_nibble < FLAG_REGISTER_COUNT);
+                    memcpy(V, cpu->flag_registers, second_nibble + 1);
+                    cpu->program_counter += 2;
                     break;
 
                 default:
@@ -427,15 +647,6 @@ enum bool Cpu_cycle(enum bool *invalidate_display) {
             unknown_opcode = TRUE;
     }
 
-    /* todo: timer depletion should be done at 60hz somewhere else, independent of the cpu cycle. */
-    if (sound_timer > 0) {
-        sound_timer--;
-        /* todo: make sound. */
-    }
-    if (delay_timer > 0) {
-        delay_timer--;
-    }
-
     if (unknown_opcode) {
         /* If there was an issue decoding the opcode,
          * there was no execution. */
@@ -446,35 +657,49 @@ enum bool Cpu_cycle(enum bool *invalidate_display) {
 
         /* Increment the program counter so we can continue execution if the
          * system decides to ignore this error. */
-        program_counter += 2;
+        cpu->program_counter += 2;
 
-        check_invariants();
+        check_invariants(cpu);
         return FALSE;
     }
 
-    check_invariants();
+    if (!is_proven(cpu)) {
+        check_invariants(cpu);
+    }
     return TRUE;
 }
 
-void Cpu_print_memory(void)
+void Cpu_tick_timers(struct Cpu *cpu)
+{
+    if (cpu->sound_timer > 0) {
+        cpu->sound_timer--;
+    }
+    if (cpu->delay_timer > 0) {
+        cpu->delay_timer--;
+    }
+}
+
+enum bool Cpu_is_halted(const struct Cpu *cpu)
 {
-    check_invariants();
+    return cpu->halted;
+}
+
+void Cpu_print_memory(const struct Cpu *cpu)
+{
+    check_invariants(cpu);
 
     uint8_t i;
 
     for (i = 0; i < 16; i++) {
-        printf("%02x ", register_v[i]);
+        printf("%02x ", cpu->register_v[i]);
     }
 
-    printf("I=%04x \n", I);
+    printf("I=%04x \n", cpu->I);
 
-    check_invariants();
+    check_invariants(cpu);
 }
 
-void Cpu_uninit(void)
+void Cpu_uninit(struct Cpu *cpu)
 {
-    check_invariants();
-
-    free(stack);
-    free(register_v);
+    check_invariants(cpu);
 }
@@ -0,0 +1,78 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "capture.h"
+#include "constant.h"
+#include "replay.h"
+
+/* Return TRUE iff. `file_name` ends in `extension`. */
+static enum bool has_extension(const char *file_name, const char *extension) {
+    size_t length = strlen(file_name);
+    size_t extension_length = strlen(extension);
+
+    return length >= extension_length
+           && strcmp(file_name + length - extension_length, extension) == 0
+           ? TRUE : FALSE;
+}
+
+/* Read back a session recorded with `-c`. Given only the capture file, print
+ * how many frames it holds; given a frame number and image files as well,
+ * seek to each frame in turn and write it out, as a GIF for file names
+ * ending in ".gif" and a PBM otherwise. */
+int main(int argc, char *argv[]) {
+    struct Capture_reader reader;
+    uint64_t *display;
+    enum bool success = TRUE;
+    int i;
+
+    if (argc < 2 || argc % 2 != 0) {
+        fprintf(stderr, "Usage: %s <capture_file> [<frame> <image_file>]...\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!Capture_open(&reader, argv[1])) {
+        return EXIT_FAILURE;
+    }
+    display = malloc((size_t) PLANE_COUNT * PLANE_WORD_COUNT
+                     * sizeof *display);
+    if (!display) {
+        Capture_close(&reader);
+        return EXIT_FAILURE;
+    }
+
+    if (argc == 2) {
+        printf("frames %lu\nkeyframes %lu\ndropped_frames %llu\n",
+               (unsigned long) reader.frame_count,
+               (unsigned long) reader.keyframe_count,
+               (unsigned long long) reader.dropped_frame_count);
+    }
+
+    for (i = 2; i < argc && success; i += 2) {
+        char *rest;
+        unsigned long frame = strtoul(argv[i], &rest, 10);
+        uint16_t width, height;
+
+        if (rest == argv[i] || *rest != '\0'
+            || !Capture_seek(&reader, (uint32_t) frame, display, &width,
+                             &height)) {
+            fprintf(stderr, "There is no frame '%s' in '%s'.\n", argv[i],
+                    argv[1]);
+            success = FALSE;
+        }
+        else if (has_extension(argv[i + 1], ".gif")) {
+            success = Replay_write_display_gif(display, width, height,
+                                               argv[i + 1]);
+        }
+        else {
+            success = Replay_write_display_pbm(display, width, height,
+                                               argv[i + 1]);
+        }
+    }
+
+    free(display);
+    Capture_close(&reader);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,109 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash.h"
+
+/* The XXH64 algorithm, as specified at https://github.com/Cyan4973/xxHash. */
+
+static const uint64_t PRIME_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME_5 = 0x27D4EB2F165667C5ULL;
+
+static uint64_t rotate_left(uint64_t value, unsigned int count)
+{
+    return value << count | value >> (64 - count);
+}
+
+/* Read little endian values regardless of the host's byte order. */
+static uint64_t read_64(const uint8_t *bytes)
+{
+    uint64_t value = 0;
+    int i;
+
+    for (i = 7; i >= 0; i--) {
+        value = value << 8 | bytes[i];
+    }
+    return value;
+}
+
+static uint32_t read_32(const uint8_t *bytes)
+{
+    return (uint32_t) bytes[0] | (uint32_t) bytes[1] << 8
+           | (uint32_t) bytes[2] << 16 | (uint32_t) bytes[3] << 24;
+}
+
+static uint64_t round_of(uint64_t accumulator, uint64_t input)
+{
+    accumulator += input * PRIME_2;
+    accumulator = rotate_left(accumulator, 31);
+    return accumulator * PRIME_1;
+}
+
+static uint64_t merge_round(uint64_t accumulator, uint64_t value)
+{
+    accumulator ^= round_of(0, value);
+    return accumulator * PRIME_1 + PRIME_4;
+}
+
+uint64_t Hash_xxh64(const void *data, size_t length, uint64_t seed)
+{
+    const uint8_t *bytes = data;
+    const uint8_t *end = bytes + length;
+    uint64_t hash;
+
+    if (length >= 32) {
+        /* Consume 32 byte stripes with four independent accumulators. */
+        uint64_t v1 = seed + PRIME_1 + PRIME_2;
+        uint64_t v2 = seed + PRIME_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME_1;
+
+        do {
+            v1 = round_of(v1, read_64(bytes));
+            v2 = round_of(v2, read_64(bytes + 8));
+            v3 = round_of(v3, read_64(bytes + 16));
+            v4 = round_of(v4, read_64(bytes + 24));
+            bytes += 32;
+        } while (end - bytes >= 32);
+
+        hash = rotate_left(v1, 1) + rotate_left(v2, 7)
+               + rotate_left(v3, 12) + rotate_left(v4, 18);
+        hash = merge_round(hash, v1);
+        hash = merge_round(hash, v2);
+        hash = merge_round(hash, v3);
+        hash = merge_round(hash, v4);
+    }
+    else {
+        hash = seed + PRIME_5;
+    }
+
+    hash += (uint64_t) length;
+
+    /* Mix in the remaining tail. */
+    while (end - bytes >= 8) {
+        hash ^= round_of(0, read_64(bytes));
+        hash = rotate_left(hash, 27) * PRIME_1 + PRIME_4;
+        bytes += 8;
+    }
+    if (end - bytes >= 4) {
+        hash ^= (uint64_t) read_32(bytes) * PRIME_1;
+        hash = rotate_left(hash, 23) * PRIME_2 + PRIME_3;
+        bytes += 4;
+    }
+    while (bytes < end) {
+        hash ^= *bytes * PRIME_5;
+        hash = rotate_left(hash, 11) * PRIME_1;
+        bytes++;
+    }
+
+    /* Final avalanche. */
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
@@ -0,0 +1,337 @@
+#include <dlfcn.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio.h"
+#include "capture.h"
+#include "chip8.h"
+#include "recompiled.h"
+#include "replay.h"
+
+/* The most frames that can be hashed or dumped in one run. */
+#define MAX_CHECKPOINT_COUNT 64
+
+/* A frame at which to hash the framebuffer or write it out as a PBM. */
+struct checkpoint {
+    uint32_t frame;
+    /* The PBM file to write, or NULL to print the hash. */
+    const char *pbm_file_name;
+};
+
+/* A second machine run in lockstep with the first, with the blocks of a
+ * program from chip8_recompile translated, to check that the translation
+ * behaves as the interpreter does. */
+struct lockstep {
+    struct Chip8 *chip8;
+    /* The machine's own place in the shared script. */
+    struct Replay_script script;
+    /* Set when its state first differs from the interpreter's. */
+    enum bool diverged;
+};
+
+/* Order checkpoints by frame. */
+static int compare_checkpoints(const void *a, const void *b) {
+    const struct checkpoint *first = a;
+    const struct checkpoint *second = b;
+
+    return (first->frame > second->frame) - (first->frame < second->frame);
+}
+
+/* Parse a frame number from `text` into `frame`, stopping at `end`. Return
+ * TRUE on success and FALSE on error. */
+static enum bool parse_frame(const char *text, char end, uint32_t *frame) {
+    char *rest;
+    unsigned long value = strtoul(text, &rest, 10);
+
+    if (rest == text || *rest != end) {
+        return FALSE;
+    }
+    *frame = (uint32_t) value;
+    return TRUE;
+}
+
+/* Load the program RECOMPILED_PROGRAM from the shared object at `path`, as
+ * built by `make <name>.recompiled.so`. The object stays loaded. Return NULL
+ * on error. */
+static const struct Recompiled_program *load_program(const char *path) {
+    const struct Recompiled_program *program;
+    void *object = dlopen(path, RTLD_NOW);
+
+    if (!object) {
+        fprintf(stderr, "The program '%s' could not be loaded: %s\n", path,
+                dlerror());
+        return NULL;
+    }
+    program = dlsym(object, "RECOMPILED_PROGRAM");
+    if (!program) {
+        fprintf(stderr, "'%s' holds no RECOMPILED_PROGRAM.\n", path);
+        dlclose(object);
+    }
+    return program;
+}
+
+/* As Replay_run, but with `audio` (if not NULL) taking the machine's sound,
+ * `capture` (if not NULL) recording each frame and `lockstep` (if not NULL)
+ * running each frame too and comparing states after it. Runs faster than
+ * real time would overrun the rings, so each frame waits for room first.
+ * Also return FALSE if the audio sink or the capture's writer fails, which
+ * leaves its ring full. */
+static enum bool run(struct Chip8 *chip8, struct Replay_script *script,
+                     uint32_t *frame, uint32_t end_frame,
+                     struct Audio *audio, struct Capture *capture,
+                     struct lockstep *lockstep) {
+    if (!audio && !capture && !lockstep) {
+        return Replay_run(chip8, script, frame, end_frame);
+    }
+
+    while (*frame < end_frame) {
+        struct timespec poll = {0, 100000};
+        uint32_t lockstep_frame = *frame;
+
+        while ((audio && !atomic_load(&audio->failed)
+                && Ring_free_size(&audio->ring)
+                   < SAMPLES_PER_FRAME * sizeof(int16_t))
+               || (capture && !atomic_load(&capture->failed)
+                   && !Capture_has_room(capture))) {
+            nanosleep(&poll, NULL);
+        }
+        if ((audio && atomic_load(&audio->failed))
+            || (capture && atomic_load(&capture->failed))) {
+            return FALSE;
+        }
+        if (!Replay_run(chip8, script, frame, *frame + 1)) {
+            return FALSE;
+        }
+        if (capture) {
+            Capture_frame(capture, chip8);
+        }
+        if (lockstep
+            && (!Replay_run(lockstep->chip8, &lockstep->script,
+                            &lockstep_frame, *frame)
+                || Chip8_state_hash(lockstep->chip8)
+                   != Chip8_state_hash(chip8))) {
+            lockstep->diverged = TRUE;
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* Run the ROM for a number of frames without a terminal, feeding it input
+ * from a script, and print the hash of the framebuffer at the end (and at
+ * each `-h` frame) as `<frame> <hash>` lines. `-p <frame>:<file>` writes
+ * the framebuffer at that frame to a PBM file instead. `-o` writes the
+ * sound to an audio file (see Audio_open_sink), and `-c` records every
+ * frame to a capture file for chip8_frames. `-l` runs the program in a
+ * shared object from chip8_recompile alongside, failing at the first frame
+ * after which the machines' states differ. `-s`, `-x` and `-v` are as for
+ * linux_chip8. */
+int main(int argc, char *argv[]) {
+    struct checkpoint checkpoints[MAX_CHECKPOINT_COUNT + 1];
+    size_t checkpoint_count = 0;
+    enum Chip8_mode mode = MODE_CHIP8;
+    enum bool vip_shifts = FALSE;
+    const char *script_file_name = NULL;
+    const char *audio_file_name = NULL;
+    const char *capture_file_name = NULL;
+    const char *program_file_name = NULL;
+    const struct Recompiled_program *program = NULL;
+    struct lockstep lockstep;
+    struct Replay_script script;
+    struct Capture capture;
+    struct Audio_sink sink;
+    struct Audio audio;
+    uint32_t frame_count = 60;
+    uint32_t frame = 0;
+    uint64_t seed = 1;
+    enum bool usage = FALSE;
+    enum bool success = TRUE;
+    struct Chip8 *chip8;
+    size_t i;
+    int option;
+
+    while ((option = getopt(argc, argv, "svxi:n:r:h:p:o:c:l:")) != -1) {
+        struct checkpoint *checkpoint = &checkpoints[checkpoint_count];
+
+        switch (option) {
+            case 's':
+                mode = MODE_SCHIP;
+                break;
+            case 'v':
+                vip_shifts = TRUE;
+                break;
+            case 'x':
+                mode = MODE_XOCHIP;
+                break;
+            case 'i':
+                script_file_name = optarg;
+                break;
+            case 'n':
+                usage = !parse_frame(optarg, '\0', &frame_count);
+                break;
+            case 'r':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'o':
+                audio_file_name = optarg;
+                break;
+            case 'c':
+                capture_file_name = optarg;
+                break;
+            case 'l':
+                program_file_name = optarg;
+                break;
+            case 'h':
+            case 'p':
+                if (checkpoint_count == MAX_CHECKPOINT_COUNT
+                    || !parse_frame(optarg, option == 'h' ? '\0' : ':',
+                                    &checkpoint->frame)) {
+                    usage = TRUE;
+                    break;
+                }
+                checkpoint->pbm_file_name = option == 'h'
+                                            ? NULL
+                                            : strchr(optarg, ':') + 1;
+                checkpoint_count++;
+                break;
+            default:
+                usage = TRUE;
+                break;
+        }
+    }
+
+    if (usage || optind != argc - 1) {
+        fprintf(stderr, "Usage: %s [-s | -x] [-v] [-i <input_script>] "
+                        "[-n <frames>] [-r <seed>] [-h <frame>]... "
+                        "[-p <frame>:<pbm_file>]... [-o <audio_file>] "
+                        "[-c <capture_file>] [-l <program_file>] "
+                        "<rom_file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* The final frame is always hashed. */
+    checkpoints[checkpoint_count].frame = frame_count;
+    checkpoints[checkpoint_count].pbm_file_name = NULL;
+    checkpoint_count++;
+    qsort(checkpoints, checkpoint_count, sizeof *checkpoints,
+          compare_checkpoints);
+
+    if (!Replay_load_script(&script, script_file_name)) {
+        return EXIT_FAILURE;
+    }
+    chip8 = Chip8_create(mode);
+    if (!chip8) {
+        Replay_free_script(&script);
+        return EXIT_FAILURE;
+    }
+    if (!Chip8_load_rom_file(chip8, argv[optind])) {
+        Chip8_destroy(chip8);
+        Replay_free_script(&script);
+        return EXIT_FAILURE;
+    }
+    Chip8_seed(chip8, seed);
+    if (vip_shifts) {
+        Chip8_add_quirks(chip8, QUIRK_SHIFT_FROM_VY);
+    }
+
+    /* The lockstep machine shares the first one's image and script. */
+    memset(&lockstep, 0, sizeof lockstep);
+    if (program_file_name) {
+        program = load_program(program_file_name);
+        lockstep.chip8 = program ? Chip8_create(mode) : NULL;
+        if (!lockstep.chip8
+            || !Chip8_load_shared_rom(lockstep.chip8, chip8)
+            || !Chip8_use_program(lockstep.chip8, program)) {
+            if (program) {
+                fprintf(stderr, "The program '%s' was not translated from "
+                                "'%s'.\n", program_file_name, argv[optind]);
+            }
+            Chip8_destroy(lockstep.chip8);
+            Chip8_destroy(chip8);
+            Replay_free_script(&script);
+            return EXIT_FAILURE;
+        }
+        Chip8_seed(lockstep.chip8, seed);
+        if (vip_shifts) {
+            Chip8_add_quirks(lockstep.chip8, QUIRK_SHIFT_FROM_VY);
+        }
+        lockstep.script = script;
+    }
+
+    if (audio_file_name) {
+        if (!Audio_open_sink(&sink, audio_file_name)
+            || !Audio_start(&audio, &sink)) {
+            Chip8_destroy(lockstep.chip8);
+            Chip8_destroy(chip8);
+            Replay_free_script(&script);
+            return EXIT_FAILURE;
+        }
+        Chip8_set_audio(chip8, &audio.ring);
+    }
+    if (capture_file_name && !Capture_start(&capture, capture_file_name)) {
+        if (audio_file_name) {
+            Chip8_set_audio(chip8, NULL);
+            Audio_stop(&audio);
+        }
+        Chip8_destroy(lockstep.chip8);
+        Chip8_destroy(chip8);
+        Replay_free_script(&script);
+        return EXIT_FAILURE;
+    }
+    /* The power on frame is the first frame of the session. */
+    if (capture_file_name) {
+        Capture_frame(&capture, chip8);
+    }
+
+    for (i = 0; i < checkpoint_count && success; i++) {
+        const struct checkpoint *checkpoint = &checkpoints[i];
+
+        if (!run(chip8, &script, &frame, checkpoint->frame,
+                 audio_file_name ? &audio : NULL,
+                 capture_file_name ? &capture : NULL,
+                 program ? &lockstep : NULL)) {
+            /* Audio and capture errors are reported once they are
+             * stopped. */
+            if (lockstep.diverged) {
+                fprintf(stderr, "The program diverged from the interpreter "
+                                "in frame %lu.\n", (unsigned long) frame);
+            }
+            else if ((!audio_file_name || !atomic_load(&audio.failed))
+                     && (!capture_file_name
+                         || !atomic_load(&capture.failed))) {
+                fprintf(stderr, "Invalid execution before frame %lu.\n",
+                        (unsigned long) frame + 1);
+            }
+            success = FALSE;
+        }
+        else if (checkpoint->pbm_file_name) {
+            success = Replay_write_pbm(chip8, checkpoint->pbm_file_name);
+        }
+        else {
+            printf("%lu %016llx\n", (unsigned long) frame,
+                   (unsigned long long) Replay_hash_frame(chip8));
+        }
+    }
+
+    if (audio_file_name) {
+        Chip8_set_audio(chip8, NULL);
+        if (!Audio_stop(&audio)) {
+            fprintf(stderr, "The audio file '%s' could not be written.\n",
+                    audio_file_name);
+            success = FALSE;
+        }
+    }
+    if (capture_file_name && !Capture_stop(&capture)) {
+        fprintf(stderr, "The capture file '%s' could not be written.\n",
+                capture_file_name);
+        success = FALSE;
+    }
+    Chip8_destroy(lockstep.chip8);
+    Chip8_destroy(chip8);
+    Replay_free_script(&script);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
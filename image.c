@@ -0,0 +1,160 @@
+/* memfd_create is a GNU extension. */
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "constant.h"
+#include "image.h"
+
+/* -------------------------------------------------------------------------- */
+/* Private Interface -------------------------------------------------------- */
+
+/* Return a descriptor for a new anonymous file, or -1 on error. */
+static int anonymous_file(void)
+{
+#ifdef __linux__
+    return memfd_create("chip8-image", MFD_CLOEXEC);
+#else
+    char path[] = "/tmp/chip8-image-XXXXXX";
+    int fd = mkstemp(path);
+
+    if (fd >= 0) {
+        unlink(path);
+    }
+    return fd;
+#endif
+}
+
+/* -------------------------------------------------------------------------- */
+/* Public Interface --------------------------------------------------------- */
+
+struct Image *Image_create(const uint8_t *rom, size_t rom_size,
+                           uint32_t memory_size)
+{
+    struct Image *image = malloc(sizeof *image);
+    uint8_t *data;
+
+    if (!image) {
+        return NULL;
+    }
+    image->memory_size = memory_size;
+    image->rom_size = rom_size < memory_size - APPLICATION_START
+                      ? rom_size : memory_size - APPLICATION_START;
+    atomic_init(&image->reference_count, 1);
+    image->analysed = FALSE;
+
+    image->fd = anonymous_file();
+    if (image->fd < 0) {
+        free(image);
+        return NULL;
+    }
+    if (ftruncate(image->fd, memory_size) != 0) {
+        close(image->fd);
+        free(image);
+        return NULL;
+    }
+
+    /* The file reads as zeros, so only the interpreter data and the
+     * ROM need to be written. */
+    data = mmap(NULL, memory_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                image->fd, 0);
+    if (data == MAP_FAILED) {
+        close(image->fd);
+        free(image);
+        return NULL;
+    }
+    memcpy(data + DIGIT_SPRITE_LOCATION[0], DIGIT_SPRITE_DATA,
+           16 * DIGIT_SPRITE_SIZE);
+    memcpy(data + BIG_DIGIT_SPRITE_LOCATION[0], BIG_DIGIT_SPRITE_DATA,
+           10 * BIG_DIGIT_SPRITE_SIZE);
+    if (image->rom_size > 0) {
+        memcpy(data + APPLICATION_START, rom, image->rom_size);
+    }
+
+    /* From here on the image is never written to again. */
+    if (mprotect(data, memory_size, PROT_READ) != 0) {
+        munmap(data, memory_size);
+        close(image->fd);
+        free(image);
+        return NULL;
+    }
+    image->data = data;
+
+    return image;
+}
+
+struct Image *Image_open(const char *rom_file_name, uint32_t memory_size)
+{
+    struct stat status;
+    struct Image *image;
+    uint8_t *rom = NULL;
+    int fd;
+
+    fd = open(rom_file_name, O_RDONLY);
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        fprintf(stderr, "The ROM file could not be loaded. "
+                        "Ensure that the '%s' file is present in the "
+                        "working directory.\n", rom_file_name);
+        return NULL;
+    }
+
+    if (status.st_size > 0) {
+        rom = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE,
+                   fd, 0);
+    }
+    close(fd);
+    if (rom == MAP_FAILED) {
+        return NULL;
+    }
+
+    image = Image_create(rom, (size_t) status.st_size, memory_size);
+    if (rom) {
+        munmap(rom, (size_t) status.st_size);
+    }
+    return image;
+}
+
+struct Image *Image_share(struct Image *image)
+{
+    atomic_fetch_add_explicit(&image->reference_count, 1,
+                              memory_order_relaxed);
+    return image;
+}
+
+uint8_t *Image_map_memory(const struct Image *image)
+{
+    uint8_t *memory = mmap(NULL, image->memory_size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE, image->fd, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+}
+
+void Image_unmap_memory(const struct Image *image, uint8_t *memory)
+{
+    munmap(memory, image->memory_size);
+}
+
+void Image_release(struct Image *image)
+{
+    /* The last holder must see every other holder's use of the image
+     * finished before freeing it. */
+    if (atomic_fetch_sub_explicit(&image->reference_count, 1,
+                                  memory_order_acq_rel) != 1) {
+        return;
+    }
+    if (image->analysed) {
+        Analysis_free(&image->analysis);
+    }
+    munmap((void *) image->data, image->memory_size);
+    close(image->fd);
+    free(image);
+}
@@ -0,0 +1,164 @@
+#ifndef CHIP8_ANALYSIS_H
+#define CHIP8_ANALYSIS_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "constant.h"
+
+/* What is known about a byte of memory, as a bit mask. */
+enum Analysis_byte {
+    /* The byte is part of a reachable instruction. */
+    BYTE_CODE = 1,
+    /* A reachable instruction starts at this byte. */
+    BYTE_INSTRUCTION = 2,
+    /* The byte may be read as data, e.g. as a sprite. */
+    BYTE_DATA = 4,
+    /* The byte may be written to by the application. */
+    BYTE_WRITTEN = 8,
+    /* The CPU invariants are proven to hold, and every access through I to
+     * stay within memory, whenever execution reaches the instruction
+     * starting at this byte. */
+    BYTE_PROVEN = 16
+};
+
+/* Decoded instruction forms, as stored in the instruction table. Forms
+ * introduced by SUPER-CHIP and XO-CHIP follow the base instruction set. */
+enum Analysis_op {
+    OP_INVALID = 0,
+    OP_CLEAR,                       /* 00E0 */
+    OP_RETURN,                      /* 00EE */
+    OP_JUMP,                        /* 1NNN */
+    OP_CALL,                        /* 2NNN */
+    OP_SKIP_EQUAL_IMMEDIATE,        /* 3XNN */
+    OP_SKIP_NOT_EQUAL_IMMEDIATE,    /* 4XNN */
+    OP_SKIP_EQUAL,                  /* 5XY0 */
+    OP_SET_IMMEDIATE,               /* 6XNN */
+    OP_ADD_IMMEDIATE,               /* 7XNN */
+    OP_SET,                         /* 8XY0 */
+    OP_OR,                          /* 8XY1 */
+    OP_AND,                         /* 8XY2 */
+    OP_XOR,                         /* 8XY3 */
+    OP_ADD,                         /* 8XY4 */
+    OP_SUBTRACT,                    /* 8XY5 */
+    OP_SHIFT_RIGHT,                 /* 8XY6 */
+    OP_SUBTRACT_REVERSE,            /* 8XY7 */
+    OP_SHIFT_LEFT,                  /* 8XYE */
+    OP_SKIP_NOT_EQUAL,              /* 9XY0 */
+    OP_SET_I,                       /* ANNN */
+    OP_JUMP_OFFSET,                 /* BNNN */
+    OP_RANDOM,                      /* CXNN */
+    OP_DRAW,                        /* DXYN */
+    OP_SKIP_PRESSED,                /* EX9E */
+    OP_SKIP_NOT_PRESSED,            /* EXA1 */
+    OP_GET_DELAY,                   /* FX07 */
+    OP_WAIT_KEY,                    /* FX0A */
+    OP_SET_DELAY,                   /* FX15 */
+    OP_SET_SOUND,                   /* FX18 */
+    OP_ADD_I,                       /* FX1E */
+    OP_DIGIT,                       /* FX29 */
+    OP_DECIMAL,                     /* FX33 */
+    OP_STORE,                       /* FX55 */
+    OP_LOAD,                        /* FX65 */
+    OP_SCROLL_DOWN,                 /* 00CN */
+    OP_SCROLL_RIGHT,                /* 00FB */
+    OP_SCROLL_LEFT,                 /* 00FC */
+    OP_EXIT,                        /* 00FD */
+    OP_LORES,                       /* 00FE */
+    OP_HIRES,                       /* 00FF */
+    OP_BIG_DIGIT,                   /* FX30 */
+    OP_SAVE_FLAGS,                  /* FX75 */
+    OP_LOAD_FLAGS,                  /* FX85 */
+    OP_SCROLL_UP,                   /* 00DN */
+    OP_SAVE_RANGE,                  /* 5XY2 */
+    OP_LOAD_RANGE,                  /* 5XY3 */
+    OP_SET_I_LONG,                  /* F000 NNNN */
+    OP_SELECT_PLANES,               /* FN01 */
+    OP_LOAD_AUDIO,                  /* F002 */
+    OP_PITCH,                       /* FX3A */
+    OP_COUNT,
+
+    OP_FIRST_SCHIP = OP_SCROLL_DOWN,
+    OP_FIRST_XOCHIP = OP_SCROLL_UP
+};
+
+/* What is known about a basic block, as a bit mask. */
+enum Analysis_block_flag {
+    /* The stack never under- or overflows on any path through the block. */
+    BLOCK_STACK_PROVEN = 1,
+    /* Every memory access through I in the block stays within memory. */
+    BLOCK_I_PROVEN = 2,
+    /* The block ends in a jump whose target depends on a register. */
+    BLOCK_DYNAMIC_EXIT = 4,
+    /* The block can branch to an address the CPU may not execute. */
+    BLOCK_BAD_EXIT = 8,
+    /* Some of the block's code may be overwritten by the application. */
+    BLOCK_SELF_MODIFYING = 16,
+    /* The CPU invariants hold and accesses through I stay within memory
+     * throughout the block. */
+    BLOCK_INVARIANTS_PROVEN = 32
+};
+
+/* A straight line run of instructions with a single entry point. */
+struct Analysis_block {
+    /* Address of the first instruction. */
+    uint16_t start;
+    /* Address one past the last byte of the last instruction. */
+    uint16_t end;
+    /* Addresses that execution may statically continue at. For a call, the
+     * second successor is the return address. */
+    uint16_t successors[2];
+    uint8_t successor_count;
+    /* Bit mask of Analysis_block_flag. */
+    uint8_t flags;
+};
+
+/* The result of statically analysing the application in memory. */
+struct Analysis {
+    /* The number of bytes of memory that were analysed. */
+    uint32_t memory_size;
+    /* One Analysis_byte bit mask for each byte of memory. */
+    uint8_t *byte_flags;
+    /* The decoded instruction table: one Analysis_op for each byte of
+     * memory, set wherever a reachable instruction starts. */
+    uint8_t *ops;
+    /* The reachable basic blocks, sorted by start address. */
+    struct Analysis_block *blocks;
+    uint32_t block_count;
+    /* TRUE iff. every reachable block has BLOCK_STACK_PROVEN. */
+    enum bool stack_proven;
+    /* The deepest the stack can get on any path, if the stack is proven. */
+    uint8_t max_stack_depth;
+    /* TRUE iff. every reachable control transfer and every write to memory
+     * was resolved, so no code outside the analysed blocks can be reached.
+     * Nothing is proven unless this holds. */
+    enum bool complete;
+    /* The Chip8_quirk profile the application expects. */
+    uint8_t quirks;
+    /* The number of instructions to run per frame for this application. */
+    uint16_t cycles_per_frame;
+    /* When the analysis was loaded from the cache, the tables above point
+     * into this read-only mapping of the cache file. */
+    void *mapping;
+    size_t mapping_size;
+};
+
+/* Recursively disassemble the application in the `memory_size` bytes at
+ * `memory` from APPLICATION_START, building its control-flow graph and
+ * proving what can be proven about it for the instruction set of `mode`.
+ * Return TRUE on success and FALSE on error. */
+enum bool Analysis_run(struct Analysis *analysis, const uint8_t *memory,
+                       uint32_t memory_size, enum Chip8_mode mode);
+
+/* Return TRUE iff. the CPU invariants, and that accesses through I stay
+ * within memory, are proven to hold at `address`. */
+enum bool Analysis_is_proven(const struct Analysis *analysis,
+                             uint32_t address);
+
+/* Write a human readable listing of the control-flow graph to `out`. */
+void Analysis_print(const struct Analysis *analysis, FILE *out);
+
+/* Free the resources held by `analysis`. */
+void Analysis_free(struct Analysis *analysis);
+
+#endif /* CHIP8_ANALYSIS_H */
@@ -0,0 +1,69 @@
+#ifndef CHIP8_AUDIO_H
+#define CHIP8_AUDIO_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "constant.h"
+#include "ring.h"
+
+/* Where generated samples end up. Sinks are written to from the output
+ * thread only, so they may block. */
+struct Audio_sink {
+    /* Write the `count` samples at `samples`. Return FALSE on error. */
+    enum bool (*write)(struct Audio_sink *sink, const int16_t *samples,
+                       size_t count);
+    /* Finish writing and free the sink's resources. Return FALSE on
+     * error. */
+    enum bool (*close)(struct Audio_sink *sink);
+
+    /* The file written to, if any, and the number of samples written. */
+    FILE *file;
+    uint64_t sample_count;
+};
+
+/* Open a sink which throws samples away. */
+void Audio_open_null_sink(struct Audio_sink *sink);
+
+/* Open a sink writing headerless 16-bit mono samples in the host's byte
+ * order to `file_name`. Return TRUE on success and FALSE on error. */
+enum bool Audio_open_raw_sink(struct Audio_sink *sink, const char *file_name);
+
+/* Open a sink writing a WAV file to `file_name`. Return TRUE on success and
+ * FALSE on error. */
+enum bool Audio_open_wav_sink(struct Audio_sink *sink, const char *file_name);
+
+/* Open the sink named by `name`: the null sink for "null", a WAV sink for
+ * names ending in ".wav", and a raw sink otherwise. Return TRUE on success
+ * and FALSE on error. */
+enum bool Audio_open_sink(struct Audio_sink *sink, const char *name);
+
+/* An output thread, which moves samples from a ring to a sink. */
+struct Audio {
+    /* The ring for a machine to generate samples into (see
+     * Chip8_set_audio), of which the output thread is the consumer. */
+    struct Ring ring;
+
+    struct Audio_sink sink;
+    pthread_t thread;
+
+    /* Set to have the thread write out what is left and exit. */
+    atomic_bool stopping;
+
+    /* Set by the thread if the sink failed. */
+    atomic_bool failed;
+};
+
+/* Start a thread writing the samples put in `audio->ring` to `sink`, which
+ * it takes over. Return TRUE on success and FALSE on error, in which case
+ * the sink is closed. */
+enum bool Audio_start(struct Audio *audio, const struct Audio_sink *sink);
+
+/* Write out the samples left in the ring, stop the thread and close the
+ * sink. Return FALSE if the sink failed and TRUE otherwise. */
+enum bool Audio_stop(struct Audio *audio);
+
+#endif /* CHIP8_AUDIO_H */
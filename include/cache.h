@@ -0,0 +1,27 @@
+#ifndef CHIP8_CACHE_H
+#define CHIP8_CACHE_H
+
+#include "analysis.h"
+#include "constant.h"
+
+/* The cache holds the result of analysing each ROM on disk, keyed by the
+ * hash of the ROM's contents and the mode, so that later launches of the
+ * same ROM can map the analysis in instead of redoing it. It lives in
+ * $CHIP8_CACHE_DIR, $XDG_CACHE_HOME/chip8 or ~/.cache/chip8, in that order
+ * of preference. Each entry also holds the ROM itself, which must match
+ * byte for byte: the analysis lets the CPU skip bounds checks, so an entry
+ * for another ROM that happens to share the hash must never be used. */
+
+/* Map the cached analysis of the `rom_size` bytes of ROM at `rom` in `mode`
+ * into `analysis`, which must be released with Analysis_free. Return TRUE if
+ * the cache held a valid entry for exactly that ROM and FALSE otherwise. */
+enum bool Cache_load(struct Analysis *analysis, const uint8_t *rom,
+                     size_t rom_size, enum Chip8_mode mode,
+                     uint32_t memory_size);
+
+/* Save `analysis` of the `rom_size` bytes of ROM at `rom` in `mode` to the
+ * cache. Return TRUE on success and FALSE on error. */
+enum bool Cache_store(const struct Analysis *analysis, const uint8_t *rom,
+                      size_t rom_size, enum Chip8_mode mode);
+
+#endif /* CHIP8_CACHE_H */
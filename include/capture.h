@@ -0,0 +1,114 @@
+#ifndef CHIP8_CAPTURE_H
+#define CHIP8_CAPTURE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "chip8.h"
+#include "constant.h"
+#include "ring.h"
+
+/* A capture file records every frame of a session:
+ *
+ * - A header: "CHIP8CAP" and a 32-bit version.
+ * - A record for each frame which differs from the one before it (frames
+ *   which do not differ are left out): its type, a keyframe or a delta; its
+ *   frame number; its resolution; and the framebuffer (both bitplanes,
+ *   most significant bit leftmost), XORed with the previous record's for a
+ *   delta, and run-length coded. A record more than ten seconds of frames
+ *   after the last keyframe is a keyframe itself.
+ * - An index of the keyframes, then a trailer giving its offset, the number
+ *   of keyframes and frames, and the number of frames which could not be
+ *   recorded, ending in "CHIP8IDX". A file cut short has no index, and is
+ *   read by scanning its records.
+ *
+ * All numbers are little endian. */
+
+/* A keyframe's place in a capture file. */
+struct Capture_keyframe {
+    uint32_t frame;
+    uint64_t offset;
+};
+
+/* Writes a session to a capture file. Frames are encoded on the emulator's
+ * thread, which only costs much when they change, and handed through a ring
+ * to a writer thread; the emulator never waits on the disk. */
+struct Capture {
+    struct Ring ring;
+    FILE *file;
+    pthread_t thread;
+    atomic_bool stopping;
+    atomic_bool failed;
+
+    /* Emulator thread: the framebuffer and resolution of the last frame
+     * recorded, which the next record is a delta from, and a buffer to
+     * encode records in. */
+    uint64_t *reference;
+    uint16_t width;
+    uint16_t height;
+    uint8_t *record;
+
+    /* Emulator thread: the number of frames captured, the last keyframe's
+     * frame number, and the number of frames which did not fit in the ring
+     * and so were not recorded. */
+    uint32_t frame_count;
+    uint32_t keyframe_frame;
+    enum bool has_keyframe;
+    uint64_t dropped_frame_count;
+
+    /* Writer thread: the offset the next record goes at, and the index of
+     * the keyframes written. */
+    uint64_t offset;
+    struct Capture_keyframe *keyframes;
+    uint32_t keyframe_count;
+    uint32_t keyframe_capacity;
+};
+
+/* Start capturing to a new capture file `file_name`. Return TRUE on success
+ * and FALSE on error. */
+enum bool Capture_start(struct Capture *capture, const char *file_name);
+
+/* Capture the current frame of `chip8` as the next frame of the session.
+ * Never blocks: a frame which does not fit in the ring is dropped, and the
+ * frames after it are recorded correctly. */
+void Capture_frame(struct Capture *capture, const struct Chip8 *chip8);
+
+/* Return TRUE iff. there is room in the ring for any frame. Hosts running
+ * unthrottled which would rather wait than drop frames wait for this before
+ * each call to Capture_frame. */
+enum bool Capture_has_room(struct Capture *capture);
+
+/* Write out the frames left in the ring and the index, stop the writer
+ * thread and close the file. Return FALSE if writing failed and TRUE
+ * otherwise. */
+enum bool Capture_stop(struct Capture *capture);
+
+/* Reads frames back out of a capture file. */
+struct Capture_reader {
+    FILE *file;
+    struct Capture_keyframe *keyframes;
+    uint32_t keyframe_count;
+    /* The number of frames in the session, the number which could not be
+     * recorded, and where the records end. */
+    uint32_t frame_count;
+    uint64_t dropped_frame_count;
+    uint64_t records_end;
+};
+
+/* Open the capture file `file_name`. Return TRUE on success and FALSE on
+ * error. */
+enum bool Capture_open(struct Capture_reader *reader, const char *file_name);
+
+/* Decode frame `frame` into `display`, laid out as the framebuffer returned
+ * by Chip8_framebuffer, and store its resolution in `width` and `height`.
+ * Return FALSE if there is no such frame or on error, and TRUE otherwise. */
+enum bool Capture_seek(struct Capture_reader *reader, uint32_t frame,
+                       uint64_t *display, uint16_t *width, uint16_t *height);
+
+/* Close the capture file. */
+void Capture_close(struct Capture_reader *reader);
+
+#endif /* CHIP8_CAPTURE_H */
@@ -1,11 +1,122 @@
 #ifndef CHIP8_CHIP8_H
 #define CHIP8_CHIP8_H
 
+#include <stddef.h>
+#include <stdio.h>
+
 #include "constant.h"
 
-/* Turn on the CHIP-8 with the application in `rom_file_name` loaded in at
- * address APPLICATION_START. Only one instance of the CHIP-8 may be active at
- * once, so make sure the CHIP-8 is off first. */
-enum bool Chip8_turn_on(char *rom_file_name);
+/* An emulated CHIP-8 system. Any number of machines may exist at once, each
+ * driven by its host one step at a time through the interface below. */
+struct Chip8;
+
+/* Create a machine running the instruction set of `mode`, with no
+ * application loaded. Return NULL on error. */
+struct Chip8 *Chip8_create(enum Chip8_mode mode);
+
+/* Load the `rom_size` bytes of the application at `rom` in at address
+ * APPLICATION_START and reset the machine to its power on state, ready to
+ * run it. The buffer is copied and need not outlive the call. Return TRUE
+ * on success and FALSE on error. */
+enum bool Chip8_load_rom(struct Chip8 *chip8, const uint8_t *rom,
+                         size_t rom_size);
+
+/* As Chip8_load_rom, with the application in `rom_file_name`. */
+enum bool Chip8_load_rom_file(struct Chip8 *chip8, const char *rom_file_name);
+
+/* As Chip8_load_rom, with the application loaded in `source`, which must
+ * run the same instruction set. The machines share one memory image and
+ * its analysis rather than each building and analysing its own, so that
+ * many machines running the same ROM cost one image between them and load
+ * without touching the ROM or the cache; the source may be unloaded or
+ * destroyed afterwards. Return FALSE if the source has no application
+ * loaded (or on error) and TRUE otherwise. */
+enum bool Chip8_load_shared_rom(struct Chip8 *chip8,
+                                const struct Chip8 *source);
+
+/* Run the blocks which chip8_recompile translated in `program` natively,
+ * interpreting the rest of the application. The loaded application must be
+ * the one the program was translated from; return FALSE if it is not (or
+ * on error) and TRUE otherwise. The program stays in use until the machine
+ * is loaded again. */
+struct Recompiled_program;
+enum bool Chip8_use_program(struct Chip8 *chip8,
+                            const struct Recompiled_program *program);
+
+/* Apply the Chip8_quirk behaviours in `quirks` on top of those picked for
+ * the loaded application, until it is loaded again. */
+void Chip8_add_quirks(struct Chip8 *chip8, uint8_t quirks);
+
+/* Seed the machine's random number generator, making runs with the same
+ * input repeatable. */
+void Chip8_seed(struct Chip8 *chip8, uint64_t seed);
+
+/* Generate the machine's sound into `ring` from now on, as 16-bit mono
+ * samples in the host's byte order at SAMPLE_RATE, SAMPLES_PER_FRAME to each
+ * frame; or stop generating it if `ring` is NULL. The machine is the ring's
+ * producer and never waits for room in it, dropping samples which do not
+ * fit instead. The ring must outlive its use. */
+struct Ring;
+void Chip8_set_audio(struct Chip8 *chip8, struct Ring *ring);
+
+/* Return the number of samples dropped for want of room in the ring since
+ * the application was loaded or the ring was set. */
+uint64_t Chip8_dropped_samples(const struct Chip8 *chip8);
+
+/* Run up to `cycles` instruction cycles, counting the timers down at each
+ * frame boundary, and stopping early if the application exits. Set
+ * invalidate_display to TRUE if the framebuffer changed, and FALSE
+ * otherwise. Return FALSE if the application executed something invalid,
+ * after which the machine must be loaded again, and TRUE otherwise. */
+enum bool Chip8_run_cycles(struct Chip8 *chip8, uint32_t cycles,
+                           enum bool *invalidate_display);
+
+/* As Chip8_run_cycles, running until the end of the current 60hz frame. */
+enum bool Chip8_run_frame(struct Chip8 *chip8, enum bool *invalidate_display);
+
+/* Return the number of instruction cycles run since the application was
+ * loaded. */
+uint64_t Chip8_cycle_count(const struct Chip8 *chip8);
+
+/* Set whether keypad key `key_number` (0-F) is held down. */
+void Chip8_set_key(struct Chip8 *chip8, uint8_t key_number,
+                   enum bool pressed);
+
+/* Return TRUE iff. the application has exited. */
+enum bool Chip8_is_halted(const struct Chip8 *chip8);
+
+/* Return the framebuffer and store its current resolution in `width` and
+ * `height`. The framebuffer holds PLANE_COUNT bitplanes, each of
+ * HIRES_HEIGHT_PIXEL_COUNT rows of ROW_WORD_COUNT words, of which the top
+ * left `width` by `height` pixels are in use. The most significant bit of
+ * a word is its leftmost pixel. The pointer stays valid until the machine
+ * is loaded again or destroyed. */
+const uint64_t *Chip8_framebuffer(const struct Chip8 *chip8,
+                                  uint16_t *width, uint16_t *height);
+
+/* Return the most bytes that Chip8_save_state can use for the machine. */
+size_t Chip8_state_size(const struct Chip8 *chip8);
+
+/* Save the state of the machine, which must have an application loaded, to
+ * `buffer` (of at least Chip8_state_size bytes) and return the number of
+ * bytes used. Only the parts of memory and the display which differ from
+ * power on are saved, so a state is usually much smaller than the bound. */
+size_t Chip8_save_state(const struct Chip8 *chip8, uint8_t *buffer);
+
+/* Restore a state saved from a machine with the same application loaded,
+ * making this machine a copy of that one. */
+void Chip8_restore_state(struct Chip8 *chip8, const uint8_t *buffer);
+
+/* Return a hash of everything that determines how the machine behaves from
+ * now on: its memory, registers, timers, keypad and display. Machines with
+ * equal state hashes almost certainly behave the same given equal input. */
+uint64_t Chip8_state_hash(const struct Chip8 *chip8);
+
+/* Write the loaded application's control-flow graph and what static
+ * analysis proves about it to `out`. */
+void Chip8_print_analysis(const struct Chip8 *chip8, FILE *out);
+
+/* Free the machine and everything it holds. */
+void Chip8_destroy(struct Chip8 *chip8);
 
 #endif /* CHIP8_CHIP8_H */
@@ -6,35 +6,82 @@
 /* Boolean data type. */
 enum bool {FALSE = 0, TRUE};
 
+/* Variants of the CHIP-8 instruction set. Each mode is a superset of the one
+ * before it: SUPER-CHIP adds a 128x64 high resolution display, scrolling and
+ * 16x16 sprites, and XO-CHIP adds 64 KB of RAM and a second bitplane. */
+enum Chip8_mode {MODE_CHIP8 = 0, MODE_SCHIP, MODE_XOCHIP};
+
+/* Behaviours which differ between interpreters, as a bit mask. */
+enum Chip8_quirk {
+    /* 8XY6 and 8XYE shift VY into VX rather than shifting VX in place, as
+     * the original COSMAC VIP interpreter did. Only set on request, since
+     * most applications name an unrelated VY and expect VX shifted. */
+    QUIRK_SHIFT_FROM_VY = 1,
+    /* BNNN jumps to XNN + VX rather than to NNN + V0. */
+    QUIRK_JUMP_VX = 2
+};
+
 /* The number of bits per byte. */
 extern const uint8_t CHAR_BIT_COUNT;
 
+/* The number of bits in a display word. */
+extern const uint8_t WORD_BIT_COUNT;
+
 /* The number of bytes in the system RAM. */
 extern const uint16_t MEMORY_SIZE;
 
+/* The number of bytes in the system RAM in XO-CHIP mode. */
+extern const uint32_t XOCHIP_MEMORY_SIZE;
+
 /* The number of entries (each capable of holding an address) in the stack. */
 extern const uint8_t STACK_SIZE;
 
+/* The number of entries in the stack in SUPER-CHIP and XO-CHIP mode. */
+extern const uint8_t SCHIP_STACK_SIZE;
+
+/* The number of persistent (RPL) flag registers saved by FX75. */
+extern const uint8_t FLAG_REGISTER_COUNT;
+
 /* The memory offset that a ROM is loaded into in memory. */
 extern const uint16_t APPLICATION_START;
 
-/* Name of file containing data for the
- * interpreter including provided digit sprites. */
-extern const char *INTERPRETER_DATA_FILE_NAME;
+/* The 4x5 digit sprites (0-F) provided by the interpreter, copied into
+ * memory at DIGIT_SPRITE_LOCATION[0] before the ROM is loaded. */
+extern const uint8_t DIGIT_SPRITE_DATA[];
 
 /* Memory locations that the provided digit
  * sprites are located at in the interpreter data. */
 extern const uint16_t DIGIT_SPRITE_LOCATION[];
 
+/* Number of bytes in each 4x5 digit sprite. */
+extern const uint8_t DIGIT_SPRITE_SIZE;
+
+/* The 8x10 SUPER-CHIP digit sprites (0-9), copied into
+ * memory at BIG_DIGIT_SPRITE_LOCATION[0]. */
+extern const uint8_t BIG_DIGIT_SPRITE_DATA[];
+
+/* Memory locations of the 8x10 SUPER-CHIP digit sprites. */
+extern const uint16_t BIG_DIGIT_SPRITE_LOCATION[];
+
+/* Number of bytes in each 8x10 SUPER-CHIP digit sprite. */
+extern const uint8_t BIG_DIGIT_SPRITE_SIZE;
+
 /* Number of CPU execution cycles per second; emulator clock speed. */
 extern const uint16_t CYCLES_PER_SECOND;
 
-/* Number of cycles to group together before pausing. */
+/* Number of cycles to group together before pausing. Each group is one
+ * 60hz frame, at which the delay and sound timers count down. */
 extern const uint16_t CYCLES_PER_DELAY;
 
 /* Number of ms to pause for after CYCLES_PER_DELAY cycles. */
 #define DELAY_MS ((uint16_t) (1000 * (CYCLES_PER_DELAY) / (CYCLES_PER_SECOND)))
 
+/* Number of audio samples per second generated from the sound timer. */
+extern const uint32_t SAMPLE_RATE;
+
+/* Number of audio samples generated per 60hz frame. */
+#define SAMPLES_PER_FRAME ((uint32_t) ((SAMPLE_RATE) * (CYCLES_PER_DELAY) / (CYCLES_PER_SECOND)))
+
 /* Number of pixels in the system's screen's width. */
 extern const uint16_t WIDTH_PIXEL_COUNT;
 
@@ -44,4 +91,20 @@ extern const uint16_t HEIGHT_PIXEL_COUNT;
 /* Total number of pixels on the system's screen. */
 #define PIXEL_COUNT ((uint16_t) ((WIDTH_PIXEL_COUNT) * (HEIGHT_PIXEL_COUNT)))
 
+/* Number of pixels in the screen's width in high resolution mode. */
+extern const uint16_t HIRES_WIDTH_PIXEL_COUNT;
+
+/* Number of pixels in the screen's height in high resolution mode. */
+extern const uint16_t HIRES_HEIGHT_PIXEL_COUNT;
+
+/* Number of display words making up one row of a bitplane. Rows are always
+ * stored at the high resolution width, whatever the current resolution. */
+#define ROW_WORD_COUNT ((uint16_t) ((HIRES_WIDTH_PIXEL_COUNT) / (WORD_BIT_COUNT)))
+
+/* Number of independent bitplanes on the XO-CHIP display. */
+extern const uint8_t PLANE_COUNT;
+
+/* Number of display words making up one full bitplane. */
+#define PLANE_WORD_COUNT ((uint16_t) ((ROW_WORD_COUNT) * (HIRES_HEIGHT_PIXEL_COUNT)))
+
 #endif /* CHIP8_CONSTANT_H */
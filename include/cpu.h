@@ -1,21 +1,113 @@
 #ifndef CHIP8_CPU_H
 #define CHIP8_CPU_H
 
+#include "analysis.h"
 #include "constant.h"
+#include "input.h"
+#include "screen.h"
 
-/* Initialize the CPU, allocate the registers,
- * and prepare to run instruction cycles. */
-enum bool Cpu_init(uint8_t *allocated_memory);
+/* The state of one CHIP-8 CPU. */
+struct Cpu {
+    /* Pointer to the system memory. */
+    uint8_t *memory;
+
+    /* The number of bytes at `memory`. */
+    uint32_t memory_size;
+
+    /* The instruction set variant being executed. */
+    enum Chip8_mode mode;
+
+    /* Chip8_quirk mask of interpreter behaviours the application expects. */
+    uint8_t quirks;
+
+    /* Set once the application asks to exit (SUPER-CHIP 00FD). */
+    enum bool halted;
+
+    /* Set while FX0A waits for a key to be pressed. */
+    enum bool waiting_for_key;
+
+    /* Static analysis of the application, if any, used to skip checking
+     * the invariants where they are proven to hold. */
+    const struct Analysis *analysis;
+
+    /* The screen drawn to and the keypad read from. */
+    struct Screen *screen;
+    struct Input *input;
+
+    /* State of the random number generator used by CXNN. */
+    uint64_t random_state;
+
+    /* Counts down at 60hz if above 0. */
+    int16_t delay_timer;
+
+    /* Counts down at 60hz and emits a tone if above 0. */
+    int16_t sound_timer;
+
+    /* ---------------------------------------------------------------------- */
+    /* CPU Managed Registers ------------------------------------------------ */
+
+    /* Points to the memory address currently being executed. */
+    uint16_t program_counter;
+
+    /* Stores return addresses for subroutine calls. Only the first
+     * `stack_size` entries, which depends on the mode, are used. */
+    uint16_t stack[16];
+    uint8_t stack_size;
+
+    /* Points to the top of the stack, the next place that a return address
+     * will be placed. */
+    int16_t stack_pointer;
+
+    /* ---------------------------------------------------------------------- */
+    /* Application Managed Registers ---------------------------------------- */
+
+    /* The CPU's 16 main registers, V0-VF. */
+    uint8_t register_v[16];
+
+    /* An additional register I is often used by the application to hold a
+     * memory address. */
+    uint16_t I;
+
+    /* SUPER-CHIP persistent (RPL) flags, written and read by FX75 and FX85. */
+    uint8_t flag_registers[16];
+
+    /* XO-CHIP 1-bit audio pattern and playback pitch, set by F002 and FX3A. */
+    uint8_t audio_pattern[16];
+    uint8_t pitch;
+};
+
+/* Initialize the CPU, clear the registers, and prepare to run instruction
+ * cycles from the `memory_size` bytes at `memory` using the instruction set
+ * of `mode` with the Chip8_quirk mask `quirks`. Sprites are drawn to
+ * `screen` and keys are read from `input`. */
+enum bool Cpu_init(struct Cpu *cpu, uint8_t *memory, uint32_t memory_size,
+                   enum Chip8_mode mode, uint8_t quirks,
+                   struct Screen *screen, struct Input *input);
+
+/* Seed the random number generator used by CXNN. */
+void Cpu_seed(struct Cpu *cpu, uint64_t seed);
+
+/* Skip the invariant checks at every address where `analysis` (which must
+ * outlive the CPU) proves that they hold. Pass NULL to always check. */
+void Cpu_use_analysis(struct Cpu *cpu, const struct Analysis *analysis);
 
 /* Run a single instruction cycle - fetch, decode, execute. Set
- * invalidate_display to 1 in a redraw is needed, and 0 otherwise. */
-enum bool Cpu_cycle(enum bool *invalidate_display);
+ * invalidate_display to 1 in a redraw is needed, and 0 otherwise. Return
+ * FALSE if the instruction was unknown or would overflow or underflow the
+ * stack, and TRUE otherwise. */
+enum bool Cpu_cycle(struct Cpu *cpu, enum bool *invalidate_display);
+
+/* Count the delay and sound timers down by one 60hz tick. */
+void Cpu_tick_timers(struct Cpu *cpu);
+
+/* Return TRUE iff. the application has asked to exit the interpreter. */
+enum bool Cpu_is_halted(const struct Cpu *cpu);
 
 /* Write the current V0-VF and I register values to stdout. */
-void Cpu_print_memory(void);
+void Cpu_print_memory(const struct Cpu *cpu);
 
 /* Free associated resources and disable the component
  * until it is initialized again. */
-void Cpu_uninit(void);
+void Cpu_uninit(struct Cpu *cpu);
 
 #endif /* CHIP8_CPU_H */
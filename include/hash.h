@@ -0,0 +1,10 @@
+#ifndef CHIP8_HASH_H
+#define CHIP8_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Return the 64-bit xxHash (XXH64) of the `length` bytes at `data`. */
+uint64_t Hash_xxh64(const void *data, size_t length, uint64_t seed);
+
+#endif /* CHIP8_HASH_H */
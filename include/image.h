@@ -0,0 +1,55 @@
+#ifndef CHIP8_IMAGE_H
+#define CHIP8_IMAGE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "analysis.h"
+#include "constant.h"
+
+/* The pristine contents of memory at power on: the interpreter data followed
+ * by a ROM at APPLICATION_START. An image is built once and shared read-only
+ * between any number of machines, each of which maps its own copy-on-write
+ * view of it as RAM, so only the pages a machine writes to cost memory. */
+struct Image {
+    /* Anonymous file holding the image, which machines map privately. */
+    int fd;
+    /* The number of bytes in the image; the size of each machine's RAM. */
+    uint32_t memory_size;
+    /* Read-only view of the whole image. */
+    const uint8_t *data;
+    /* The number of bytes of the ROM in the image. */
+    size_t rom_size;
+    /* The number of references to the image, each released once. */
+    atomic_uint reference_count;
+    /* The analysis of the ROM, if `analysed`. It is filled in by whoever
+     * holds the only reference, before the image is shared, and read-only
+     * from then on, so that machines sharing the image share it too. */
+    struct Analysis analysis;
+    enum bool analysed;
+};
+
+/* Build an image of `memory_size` bytes holding the `rom_size` bytes of ROM
+ * at `rom`, with a single reference to it. Return NULL on error. */
+struct Image *Image_create(const uint8_t *rom, size_t rom_size,
+                           uint32_t memory_size);
+
+/* As Image_create, with the ROM in `rom_file_name`, which is mapped rather
+ * than read. */
+struct Image *Image_open(const char *rom_file_name, uint32_t memory_size);
+
+/* Take another reference to `image`, from any thread, and return it. */
+struct Image *Image_share(struct Image *image);
+
+/* Map a private, writable copy of the image to serve as a machine's RAM.
+ * Return NULL on error. */
+uint8_t *Image_map_memory(const struct Image *image);
+
+/* Release RAM returned by Image_map_memory. */
+void Image_unmap_memory(const struct Image *image, uint8_t *memory);
+
+/* Release a reference to the image, freeing it and its analysis with the
+ * last one. RAM already mapped from it stays valid. */
+void Image_release(struct Image *image);
+
+#endif /* CHIP8_IMAGE_H */
@@ -3,20 +3,38 @@
 
 #include "constant.h"
 
-/* Initialize the input hardware. */
-enum bool Inp_init(void);
+/* The state of the system's hexadecimal keypad, as set by the host. */
+struct Input {
+    /* Bit mask of the keys (0-F) which are currently held down. */
+    uint16_t held_keys;
+
+    /* Bit mask of the keys pressed since the presses were last cleared,
+     * so that a press shorter than a frame is not missed. */
+    uint16_t pressed_keys;
+};
+
+/* Initialize the input hardware with every key released. */
+enum bool Inp_init(struct Input *input);
+
+/* Set whether `key_number` (0-F) is held down. */
+void Inp_set_key(struct Input *input, uint8_t key_number, enum bool pressed);
 
 /* Return true if `key_number` (0-F) is currently pressed. */
-uint8_t Inp_is_pressed(uint8_t key_number);
+uint8_t Inp_is_pressed(const struct Input *input, uint8_t key_number);
+
+/* Forget the key presses seen so far. */
+void Inp_clear_presses(struct Input *input);
 
-/* Block until the next key press, and return it (0-F). */
-uint8_t Inp_blocking_next(void);
+/* If a key has been pressed since the presses were last cleared, consume
+ * the lowest such key, store it (0-F) in `key_number` and return TRUE.
+ * Return FALSE otherwise. */
+enum bool Inp_next_press(struct Input *input, uint8_t *key_number);
 
 /* Print the current keypad state to stdout. */
-void Inp_print(void);
+void Inp_print(const struct Input *input);
 
 /* Free associated resources and disable the component
  * until it is initialized again. */
-void Inp_uninit(void);
+void Inp_uninit(struct Input *input);
 
 #endif /* CHIP8_INPUT_H */
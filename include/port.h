@@ -3,20 +3,49 @@
 
 #include "constant.h"
 
+/* -------------------------------------------------------------------------- */
+/* Setup -------------------------------------------------------------------- */
+
+/* Prepare the host for reading keys and showing frames. Return TRUE on
+ * success and FALSE on error. */
+enum bool Port_init(void);
+
+/* Restore the host to the way it was before Port_init. */
+void Port_uninit(void);
+
+/* Return TRUE iff. the user has asked the emulator to quit, which it should
+ * then do in an orderly way. */
+enum bool Port_quit_requested(void);
+
 /* -------------------------------------------------------------------------- */
 /* Input -------------------------------------------------------------------- */
 
+/* Take in the keys pressed since the last call, without blocking. */
+void Port_poll_input(void);
+
 /* Return TRUE iff. `key_number` (0-F) is currently pressed. */
 enum bool Port_is_pressed(uint8_t key_number);
 
-/* Block until the next key press and return it (0-F). */
-uint8_t Port_blocking_next(void);
+/* Requests to the emulator itself rather than to the application. */
+enum Port_command {
+    PORT_COMMAND_NONE = 0,
+    PORT_COMMAND_SLOWER,
+    PORT_COMMAND_FASTER,
+    PORT_COMMAND_NORMAL_SPEED
+};
+
+/* Return the next command taken in by Port_poll_input, in the order given,
+ * or PORT_COMMAND_NONE once there are no more. */
+enum Port_command Port_next_command(void);
 
 /* -------------------------------------------------------------------------- */
 /* Output ------------------------------------------------------------------- */
 
-/* Visualize the display, showing the current frame. */
-void Port_display_screen(uint8_t *display);
+/* Visualize the display, showing the current frame. `display` holds
+ * PLANE_COUNT bitplanes laid out as described in screen.h, of which the
+ * top left `width` by `height` pixels are in use. */
+void Port_display_screen(const uint64_t *display,
+                         uint16_t width, uint16_t height);
 
 /* Reset the screen so a new frame may be shown. */
 void Port_clear_screen(void);
@@ -0,0 +1,39 @@
+#ifndef CHIP8_RECOMPILED_H
+#define CHIP8_RECOMPILED_H
+
+#include <stddef.h>
+
+#include "constant.h"
+#include "cpu.h"
+
+/* A basic block of the application translated ahead of time into a native
+ * function by chip8_recompile. */
+struct Recompiled_block {
+    /* Address of the block's first instruction. */
+    uint16_t address;
+
+    /* Execute at most `budget` (at least 1) of the block's instructions
+     * from its first one, leaving the program counter at the next
+     * instruction to execute. Set invalidate_display to TRUE if the display
+     * changed, leaving it alone otherwise. Return the number of
+     * instructions executed, which is 0 if the block's code has been
+     * overwritten or it must otherwise be interpreted instead, or -1 if an
+     * instruction was invalid or overflowed or underflowed the stack. */
+    int (*run)(struct Cpu *cpu, int budget, enum bool *invalidate_display);
+};
+
+/* An application translated ahead of time, as emitted by chip8_recompile
+ * under the name RECOMPILED_PROGRAM. */
+struct Recompiled_program {
+    /* The instruction set and ROM the program was translated from. It only
+     * runs with the same ROM loaded. */
+    enum Chip8_mode mode;
+    const uint8_t *rom;
+    size_t rom_size;
+
+    /* The translated blocks, sorted by address. */
+    const struct Recompiled_block *blocks;
+    uint32_t block_count;
+};
+
+#endif /* CHIP8_RECOMPILED_H */
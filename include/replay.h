@@ -0,0 +1,61 @@
+#ifndef CHIP8_REPLAY_H
+#define CHIP8_REPLAY_H
+
+#include <stddef.h>
+
+#include "chip8.h"
+#include "constant.h"
+
+/* A change to the keypad at the start of an emulated frame. */
+struct Replay_event {
+    uint32_t frame;
+    uint8_t key_number;
+    enum bool pressed;
+};
+
+/* Scripted keypad input for running a machine without a terminal. */
+struct Replay_script {
+    /* The events, in frame order. */
+    struct Replay_event *events;
+    size_t event_count;
+    /* The index of the next event to apply. */
+    size_t next_event;
+};
+
+/* Load the script in `file_name`, or an empty script if it is NULL. Each
+ * line of the file is `<frame> <key> down` or `<frame> <key> up`, where
+ * the key is a hexadecimal digit, in frame order; blank lines and lines
+ * starting with `#` are ignored. Return TRUE on success and FALSE on error. */
+enum bool Replay_load_script(struct Replay_script *script,
+                             const char *file_name);
+
+/* Run `chip8` frame by frame from frame `*frame` up to (but not including)
+ * frame `end_frame`, applying the script's events at the start of their
+ * frames, and advance `*frame`. Return FALSE if the application executed
+ * something invalid and TRUE otherwise, including if it exited. */
+enum bool Replay_run(struct Chip8 *chip8, struct Replay_script *script,
+                     uint32_t *frame, uint32_t end_frame);
+
+/* Return a hash of the pixels and resolution of the framebuffer. The hash
+ * is the same whatever the host's byte order. */
+uint64_t Replay_hash_frame(const struct Chip8 *chip8);
+
+/* Write the framebuffer to `file_name` as a binary PBM image, in which a
+ * pixel is black if it is on in any bitplane. Return TRUE on success and
+ * FALSE on error. */
+enum bool Replay_write_pbm(const struct Chip8 *chip8, const char *file_name);
+
+/* As Replay_write_pbm, for the framebuffer `display` at a resolution of
+ * `width` by `height`, laid out as Chip8_framebuffer returns it. */
+enum bool Replay_write_display_pbm(const uint64_t *display, uint16_t width,
+                                   uint16_t height, const char *file_name);
+
+/* As Replay_write_display_pbm, as a GIF image in which each combination of
+ * bitplanes has a shade of its own. */
+enum bool Replay_write_display_gif(const uint64_t *display, uint16_t width,
+                                   uint16_t height, const char *file_name);
+
+/* Free the resources held by `script`. */
+void Replay_free_script(struct Replay_script *script);
+
+#endif /* CHIP8_REPLAY_H */
@@ -0,0 +1,42 @@
+#ifndef CHIP8_RING_H
+#define CHIP8_RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "constant.h"
+
+/* A byte queue between exactly one producer thread and one consumer thread.
+ * Neither side ever waits on the other: writes which do not fit fail
+ * instead, and reads take only what is there. */
+struct Ring {
+    uint8_t *buffer;
+    /* The capacity minus one; the capacity is a power of 2. */
+    size_t mask;
+    /* The total number of bytes ever written and ever read. Each is only
+     * stored to by one side, and on a cache line of its own so that the
+     * two sides do not contend. */
+    _Alignas(64) atomic_size_t write_count;
+    _Alignas(64) atomic_size_t read_count;
+};
+
+/* Initialize an empty ring holding at least `capacity` bytes. Return TRUE
+ * on success and FALSE on error. */
+enum bool Ring_init(struct Ring *ring, size_t capacity);
+
+/* Producer: append all `size` bytes at `data`. Return FALSE, writing
+ * nothing, if there is not room for all of them. */
+enum bool Ring_write(struct Ring *ring, const void *data, size_t size);
+
+/* Producer: return the number of bytes there is room for. */
+size_t Ring_free_size(struct Ring *ring);
+
+/* Consumer: take up to `size` bytes into `data`, returning how many there
+ * were. Bytes come out in the order they went in. */
+size_t Ring_read(struct Ring *ring, void *data, size_t size);
+
+/* Free the resources held by `ring`. */
+void Ring_uninit(struct Ring *ring);
+
+#endif /* CHIP8_RING_H */
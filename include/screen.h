@@ -1,23 +1,74 @@
 #ifndef CHIP8_SCREEN_H
 #define CHIP8_SCREEN_H
 
+#include "constant.h"
+
+/* The system's screen. */
+struct Screen {
+    /* PLANE_COUNT bitplanes of HIRES_HEIGHT_PIXEL_COUNT rows, each row being
+     * ROW_WORD_COUNT words. Each bit represents the on/off state of a single
+     * pixel, with the most significant bit of a word leftmost, so that whole
+     * rows can be shifted and XORed a word at a time. In low resolution only
+     * the top left part of each plane is used. */
+    uint64_t *display;
+
+    /* The current resolution of the screen. */
+    uint16_t width;
+    uint16_t height;
+
+    /* The number of words of each row which are in use at this resolution. */
+    uint16_t row_word_count;
+
+    /* Bit mask of the bitplanes affected by drawing, clearing and
+     * scrolling. */
+    uint8_t selected_planes;
+
+    /* SUPER-CHIP clips sprites at the edges of the screen; the other
+     * modes wrap them around to the opposite edge. */
+    enum bool clip_sprites;
+};
+
 /* Initialize the screen, allocate memory for the display. Return TRUE on
- * success and FALSE on error. */
-enum bool Screen_init(void);
+ * success and FALSE on error. The screen starts in low resolution with only
+ * the first bitplane selected. */
+enum bool Screen_init(struct Screen *screen, enum Chip8_mode mode);
+
+/* XOR a sprite onto every selected bitplane with its top left corner at
+ * (`x`,`y`). The sprite is `height` rows of `width` (8 or 16) pixels, one
+ * bit per pixel with the most significant bit leftmost. When more than one
+ * plane is selected, the sprite data for each plane follows the data for the
+ * previous one. Return the number of sprite rows that cleared a pixel, which
+ * is the system's version of collision detection. */
+uint8_t Screen_draw_sprite(struct Screen *screen, uint8_t x, uint8_t y,
+                           const uint8_t *sprite, uint8_t width, uint8_t height);
+
+/* Clear the selected bitplanes, turning every pixel off. */
+void Screen_clear(struct Screen *screen);
+
+/* Switch between the 64x32 and 128x64 resolutions. The display is cleared. */
+void Screen_set_hires(struct Screen *screen, enum bool hires);
+
+/* Return TRUE iff. the screen is in the 128x64 resolution. */
+enum bool Screen_is_hires(const struct Screen *screen);
 
-/* Paint a pixel by XORing `value` onto the display at the position (`x`,`y`).
- * Return TRUE if a pixel was cleared this way and FALSE otherwise
- * which is the system's version of collision detection. */
-enum bool Screen_paint(uint8_t x, uint8_t y, uint8_t value);
+/* Select which bitplanes (bit 0 for the first, bit 1 for the second) are
+ * affected by drawing, clearing and scrolling. */
+void Screen_select_planes(struct Screen *screen, uint8_t plane_mask);
 
-/* Clear the display, turning every pixel off. */
-void Screen_clear(void);
+/* Scroll the selected bitplanes by `count` pixels in the given direction.
+ * Pixels scrolled in from the edge are off. */
+void Screen_scroll_down(struct Screen *screen, uint8_t count);
+void Screen_scroll_up(struct Screen *screen, uint8_t count);
+void Screen_scroll_left(struct Screen *screen, uint8_t count);
+void Screen_scroll_right(struct Screen *screen, uint8_t count);
 
-/*todo:*/
-void Screen_display(void);
+/* Return the display (laid out as described above) and store the current
+ * resolution in `width` and `height`. */
+const uint64_t *Screen_framebuffer(const struct Screen *screen,
+                                   uint16_t *width, uint16_t *height);
 
 /* Free associated resources and disable the component
  * until it is initialized again. */
-void Screen_uninit(void);
+void Screen_uninit(struct Screen *screen);
 
 #endif /* CHIP8_SCREEN_H */
@@ -0,0 +1,43 @@
+#ifndef CHIP8_SET_H
+#define CHIP8_SET_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "constant.h"
+
+/* A set of 64-bit hashes which any number of threads may add to at once
+ * without locking: an open-addressing table with linear probing, in which
+ * each slot is claimed with a single compare-and-swap. */
+struct Set {
+    _Atomic uint64_t *slots;
+    /* The number of slots minus one; the number of slots is a power of 2. */
+    size_t mask;
+    atomic_size_t count;
+};
+
+enum Set_result {
+    /* The hash was not in the set, and now is. */
+    SET_ADDED,
+    /* The hash was already in the set. */
+    SET_PRESENT,
+    /* The hash was not in the set and there is no room left for it. */
+    SET_FULL
+};
+
+/* Initialize an empty set with room for at least `capacity` hashes, which
+ * it holds while at most half full. Return TRUE on success and FALSE on
+ * error. */
+enum bool Set_init(struct Set *set, size_t capacity);
+
+/* Add `hash` to the set. Hashes 0 and 1 are treated as the same hash. */
+enum Set_result Set_add(struct Set *set, uint64_t hash);
+
+/* Return the number of hashes in the set. */
+size_t Set_count(const struct Set *set);
+
+/* Free the resources held by `set`. */
+void Set_uninit(struct Set *set);
+
+#endif /* CHIP8_SET_H */
@@ -0,0 +1,47 @@
+#ifndef CHIP8_SOUND_H
+#define CHIP8_SOUND_H
+
+#include <stdint.h>
+
+#include "constant.h"
+#include "cpu.h"
+#include "ring.h"
+
+/* The sound generator, which turns the sound timer into 16-bit mono PCM at
+ * SAMPLE_RATE, SAMPLES_PER_FRAME samples to each emulated frame. While the
+ * timer is running the CPU's 1-bit audio pattern plays on a loop at the rate
+ * its pitch sets; otherwise there is silence. */
+struct Sound {
+    /* Where the samples go. The generator is the ring's producer. */
+    struct Ring *ring;
+
+    /* The number of samples of the current frame generated so far. */
+    uint32_t frame_samples;
+
+    /* The state samples are being generated from, as of the last time
+     * they were brought up to date with the CPU. */
+    enum bool playing;
+    uint8_t pitch;
+
+    /* The position in the audio pattern, in 1/2^32ths of a bit, and how far
+     * it moves each sample at `pitch`. */
+    uint64_t phase;
+    uint64_t phase_step;
+
+    /* The number of samples which did not fit in the ring. */
+    uint64_t dropped_samples;
+};
+
+/* Initialize a generator writing samples for `cpu` to `ring`. */
+void Sound_init(struct Sound *sound, struct Ring *ring, const struct Cpu *cpu);
+
+/* Generate the samples up to sample `frame_sample` of the current frame
+ * from the old state, and bring the generator up to date with `cpu`. Never
+ * blocks: samples which do not fit in the ring are dropped. */
+void Sound_render(struct Sound *sound, const struct Cpu *cpu,
+                  uint32_t frame_sample);
+
+/* Generate the rest of the current frame and start the next one. */
+void Sound_end_frame(struct Sound *sound, const struct Cpu *cpu);
+
+#endif /* CHIP8_SOUND_H */
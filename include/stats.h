@@ -0,0 +1,85 @@
+#ifndef CHIP8_STATS_H
+#define CHIP8_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "constant.h"
+
+/* Values below 2^HISTOGRAM_SUB_BUCKET_BITS are counted exactly; larger ones
+ * in buckets a 1/2^(HISTOGRAM_SUB_BUCKET_BITS - 1) fraction of their size
+ * wide, so every recorded value is known to within 1.6%. */
+#define HISTOGRAM_SUB_BUCKET_BITS 7
+
+/* Enough buckets for any 64-bit value. */
+#define HISTOGRAM_BUCKET_COUNT \
+    ((64 - HISTOGRAM_SUB_BUCKET_BITS + 2) << (HISTOGRAM_SUB_BUCKET_BITS - 1))
+
+/* A log-linear histogram in the style of HdrHistogram: constant relative
+ * precision over the whole range of values, in fixed space, with recording
+ * a matter of a few instructions. */
+struct Histogram {
+    uint64_t counts[HISTOGRAM_BUCKET_COUNT];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+};
+
+/* Initialize an empty histogram. */
+void Histogram_init(struct Histogram *histogram);
+
+/* Count one occurrence of `value`. */
+void Histogram_record(struct Histogram *histogram, uint64_t value);
+
+/* Return the value which `percentile` percent of the recorded values are no
+ * greater than, to within the histogram's precision, or 0 if none were. */
+uint64_t Histogram_percentile(const struct Histogram *histogram,
+                              double percentile);
+
+/* What a host driving a machine in real time measures. */
+enum Stats_histogram {
+    /* Instruction cycles executed per frame. */
+    STATS_FRAME_CYCLES,
+    /* Nanoseconds spent showing each frame which changed. */
+    STATS_DISPLAY_NS,
+    /* Nanoseconds each frame's delay lasted beyond what was asked for. */
+    STATS_DELAY_OVERSHOOT_NS,
+    /* Nanoseconds from a key press being read to the end of showing the
+     * next frame which changed. */
+    STATS_KEY_LATENCY_NS,
+    STATS_HISTOGRAM_COUNT
+};
+
+/* Counters and histograms describing a run. */
+struct Stats {
+    /* When the run started, as returned by Stats_now_ns. */
+    uint64_t start_ns;
+
+    uint64_t frame_count;
+    uint64_t displayed_frame_count;
+    /* Changed frames which were never shown, being replaced too soon. */
+    uint64_t skipped_frame_count;
+    uint64_t cycle_count;
+    uint64_t key_press_count;
+    uint64_t dropped_sample_count;
+
+    struct Histogram histograms[STATS_HISTOGRAM_COUNT];
+};
+
+/* Return the current time in nanoseconds, from an arbitrary fixed point. */
+uint64_t Stats_now_ns(void);
+
+/* Initialize `stats` for a run starting now. */
+void Stats_init(struct Stats *stats);
+
+/* Write a report of `stats` to `file`: one line per counter, and one per
+ * histogram giving its count, mean and percentiles. */
+void Stats_write(const struct Stats *stats, FILE *file);
+
+/* Replace the file `file_name` with a report of `stats`, atomically, so
+ * that readers polling it never see a partial report. Return TRUE on
+ * success and FALSE on error. */
+enum bool Stats_save(const struct Stats *stats, const char *file_name);
+
+#endif /* CHIP8_STATS_H */
@@ -5,52 +5,75 @@
 
 #include "input.h"
 
-/* The system uses a hexadecimal keypad with these labels. */
-static const int INPUT_PAD[] = {'0','1','2','3','4','5','6','7','8','9','A','B','C','D','E','F'};
-
 /* The number of input keys to the system. */
 static const int KEY_COUNT = 16;
 
-enum bool Inp_init(void)
+enum bool Inp_init(struct Input *input)
 {
+    input->held_keys = 0;
+    input->pressed_keys = 0;
     return TRUE;
 }
 
-uint8_t Inp_is_pressed(uint8_t key_number)
+void Inp_set_key(struct Input *input, uint8_t key_number, enum bool pressed)
 {
+    uint16_t bit;
+
     assert(key_number < KEY_COUNT);
 
-    //unsigned short key_state = (unsigned short) GetAsyncKeyState(INPUT_PAD[key_number]);
-    //return (uint8_t) (key_state > 0);
-    return 0;
+    bit = (uint16_t) (1u << key_number);
+    if (pressed) {
+        /* Only a key going down counts as a press. */
+        if (!(input->held_keys & bit)) {
+            input->pressed_keys |= bit;
+        }
+        input->held_keys |= bit;
+    }
+    else {
+        input->held_keys &= (uint16_t) ~bit;
+    }
 }
 
-uint8_t Inp_blocking_next(void)
+uint8_t Inp_is_pressed(const struct Input *input, uint8_t key_number)
 {
-    for (;;) {/*
-        int c = getch();
-        if (c >= '0' && c <= '9') {
-            return (uint8_t) (c - '0');
+    assert(key_number < KEY_COUNT);
+
+    return (uint8_t) ((input->held_keys >> key_number) & 1u);
+}
+
+void Inp_clear_presses(struct Input *input)
+{
+    input->pressed_keys = 0;
+}
+
+enum bool Inp_next_press(struct Input *input, uint8_t *key_number)
+{
+    uint8_t i;
+
+    for (i = 0; i < KEY_COUNT; i++) {
+        if ((input->pressed_keys >> i) & 1u) {
+            input->pressed_keys &= (uint16_t) ~(1u << i);
+            *key_number = i;
+            return TRUE;
         }
-        if (c >= 'a' && c <= 'f') {
-            return (uint8_t) (9 + c - 'a');
-        }*/
     }
+
+    return FALSE;
 }
 
-void Inp_print(void)
+void Inp_print(const struct Input *input)
 {
     uint8_t i;
 
     printf("%s", "Key: ");
     for (i = 0; i < KEY_COUNT; i++) {
-        printf("%d ", Inp_is_pressed(i));
+        printf("%d ", Inp_is_pressed(input, i));
     }
 
     printf("\n");
 }
 
-void Inp_uninit(void)
+void Inp_uninit(struct Input *input)
 {
-    return;
+    (void) input;
 }
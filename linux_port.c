@@ -1,23 +1,207 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <limits.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <termios.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "constant.h"
+#include "port.h"
+#include "stats.h"
+
+/* The hexadecimal keypad is laid out on the left of a QWERTY keyboard:
+ *
+ *     1 2 3 C        1 2 3 4
+ *     4 5 6 D   <-   q w e r
+ *     7 8 9 E        a s d f
+ *     A 0 B F        z x c v
+ */
+/* The keyboard key for each keypad key (0-F). */
+static const char KEYBOARD_KEYS[] = "x123qweasdzc4rfv";
+
+/* The keyboard keys for the emulator's own commands, indexed by command. */
+static const char COMMAND_KEYS[] = " -=0";
+
+/* The commands taken in but not yet handed out, as a queue. */
+#define COMMAND_QUEUE_SIZE 16
+static enum Port_command commands[COMMAND_QUEUE_SIZE];
+static unsigned int command_start, command_count;
+
+/* A terminal only reports key presses (repeated while a key is held), never
+ * releases, so a key counts as held for this long after it was last seen. */
+static const long KEY_HOLD_MS = 150;
+
+/* When each keypad key was last seen, in ms, or 0 if it never was. */
+static long key_seen_ms[16];
+
+/* Characters used for a pixel, indexed by its value in the second bitplane
+ * (high bit) and first bitplane (low bit). */
+static const char PIXEL_CHARS[] = {' ', '#', '+', '@'};
+
+/* The terminal settings to restore at exit, if they were changed. */
+static struct termios original_termios;
+static int termios_changed;
+
+/* Set once an interrupt or termination signal has arrived. */
+static volatile sig_atomic_t quit_requested;
+
+/* -------------------------------------------------------------------------- */
+/* Private Interface -------------------------------------------------------- */
+
+/* Return the time in milliseconds, never 0. */
+static long now_ms(void) {
+    return (long) (Stats_now_ns() / 1000000u) + 1;
+}
+
+static void restore_terminal(void) {
+    if (termios_changed) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &original_termios);
+        termios_changed = 0;
+    }
+}
+
+/* Ask the emulator to quit at the first interrupt, so that it can finish
+ * writing out what it has to; at the second, put the terminal back and
+ * die. */
+static void handle_signal(int signal_number) {
+    if (!quit_requested) {
+        quit_requested = 1;
+        return;
+    }
+    restore_terminal();
+    signal(signal_number, SIG_DFL);
+    raise(signal_number);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Public Interface --------------------------------------------------------- */
+
+enum bool Port_init(void) {
+    struct termios raw;
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    /* Input only works from a terminal; otherwise no key is ever held. */
+    if (!isatty(STDIN_FILENO)) {
+        return TRUE;
+    }
+    if (tcgetattr(STDIN_FILENO, &original_termios) != 0) {
+        return FALSE;
+    }
+
+    /* Read keys as they are typed, without echoing them or waiting. */
+    raw = original_termios;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) != 0) {
+        return FALSE;
+    }
+    termios_changed = 1;
 
-void Port_display_screen(uint8_t *display) {
-    unsigned int i, j;
+    atexit(restore_terminal);
+    return TRUE;
+}
+
+void Port_uninit(void) {
+    restore_terminal();
+}
+
+enum bool Port_quit_requested(void) {
+    return quit_requested ? TRUE : FALSE;
+}
+
+void Port_poll_input(void) {
+    char buffer[64];
+    ssize_t length;
+    ssize_t i;
+
+    if (!termios_changed) {
+        return;
+    }
+
+    while ((length = read(STDIN_FILENO, buffer, sizeof buffer)) > 0) {
+        for (i = 0; i < length; i++) {
+            uint8_t key;
+            uint8_t command;
+
+            for (key = 0; key < sizeof KEYBOARD_KEYS - 1; key++) {
+                if (buffer[i] == KEYBOARD_KEYS[key]) {
+                    key_seen_ms[key] = now_ms();
+                }
+            }
+
+            /* Commands beyond what the queue holds are dropped. */
+            for (command = 1; command < sizeof COMMAND_KEYS - 1; command++) {
+                if (buffer[i] == COMMAND_KEYS[command]
+                    && command_count < COMMAND_QUEUE_SIZE) {
+                    commands[(command_start + command_count++)
+                             % COMMAND_QUEUE_SIZE] =
+                        (enum Port_command) command;
+                }
+            }
+        }
+    }
+}
+
+enum bool Port_is_pressed(uint8_t key_number) {
+    return key_seen_ms[key_number]
+           && now_ms() - key_seen_ms[key_number] < KEY_HOLD_MS
+           ? TRUE : FALSE;
+}
+
+enum Port_command Port_next_command(void) {
+    enum Port_command command;
+
+    if (command_count == 0) {
+        return PORT_COMMAND_NONE;
+    }
+    command = commands[command_start];
+    command_start = (command_start + 1) % COMMAND_QUEUE_SIZE;
+    command_count--;
+    return command;
+}
 
-    for (i = 0; i < PIXEL_COUNT / CHAR_BIT; i++) {
-        if (i % (WIDTH_PIXEL_COUNT / CHAR_BIT) == 0) {
-            printf("\n");
+void Port_display_screen(const uint64_t *display,
+                         uint16_t width, uint16_t height) {
+    static char *frame;
+    unsigned int x, y;
+    size_t length = 0;
+
+    /* The whole frame is built up first and written in one go, since a
+     * 128x64 screen is far too many pixels to print one at a time. */
+    if (!frame) {
+        frame = malloc(HIRES_HEIGHT_PIXEL_COUNT
+                       * (2 * HIRES_WIDTH_PIXEL_COUNT + 1) + 2);
+        if (!frame) {
+            return;
         }
-        for (j = 0; j < CHAR_BIT; j++) {
-            printf("%c ", (display[i] >> j) & 1u ? '#' : ' ');
+    }
+
+    frame[length++] = '\n';
+    for (y = 0; y < height; y++) {
+        const uint64_t *first = display + y * ROW_WORD_COUNT;
+        const uint64_t *second = first + PLANE_WORD_COUNT;
+
+        for (x = 0; x < width; x++) {
+            unsigned int word = x / WORD_BIT_COUNT;
+            unsigned int bit = WORD_BIT_COUNT - 1 - x % WORD_BIT_COUNT;
+            unsigned int value = ((first[word] >> bit) & 1u)
+                                 | ((second[word] >> bit) & 1u) << 1;
+
+            frame[length++] = PIXEL_CHARS[value];
+            frame[length++] = ' ';
         }
+        frame[length++] = '\n';
     }
 
-    printf("\n");
+    fwrite(frame, 1, length, stdout);
+    fflush(stdout);
 }
 
 void Port_clear_screen() {
@@ -26,6 +210,11 @@ void Port_clear_screen() {
 }
 
 void Port_delay(uint16_t ms) {
-    clock_t end_clocks = clock() + ms * (CLOCKS_PER_SEC / 1000.0);
-    while (clock() < end_clocks);
+    struct timespec duration;
+
+    /* Sleep rather than spin, on the clock the frame schedule keeps to. A
+     * signal cuts the delay short, which only brings a quit forward. */
+    duration.tv_sec = ms / 1000;
+    duration.tv_nsec = (long) (ms % 1000) * 1000000L;
+    clock_nanosleep(CLOCK_MONOTONIC, 0, &duration, NULL);
 }
@@ -0,0 +1,441 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "audio.h"
+#include "capture.h"
+#include "chip8.h"
+#include "port.h"
+#include "stats.h"
+
+#ifdef CHIP8_RECOMPILED
+#include "recompiled.h"
+
+/* The application this executable was built from, as translated by
+ * chip8_recompile. */
+extern const struct Recompiled_program RECOMPILED_PROGRAM;
+#endif
+
+/* How often the live stats file is rewritten. */
+static const uint64_t STATS_SAVE_INTERVAL_NS = 1000000000u;
+
+/* Telemetry on the run loop, gathered when a stats file is given. */
+struct telemetry {
+    struct Stats stats;
+    const char *file_name;
+
+    /* When the stats file is next due to be rewritten. */
+    uint64_t next_save_ns;
+
+    /* The keys held as of the last poll, and when the earliest key press
+     * not yet followed by a changed frame was read, or 0. */
+    uint16_t held_keys;
+    uint64_t key_press_ns;
+};
+
+/* Count the keys in `held_keys` which were not held at the last poll as
+ * pressed, timing the earliest until the next changed frame. */
+static void note_keys(struct telemetry *telemetry, uint16_t held_keys) {
+    uint16_t pressed_keys = held_keys & (uint16_t) ~telemetry->held_keys;
+    uint8_t key;
+
+    for (key = 0; key < 16; key++) {
+        telemetry->stats.key_press_count += pressed_keys >> key & 1u;
+    }
+    if (pressed_keys && !telemetry->key_press_ns) {
+        telemetry->key_press_ns = Stats_now_ns();
+    }
+    telemetry->held_keys = held_keys;
+}
+
+/* The speeds that the speed commands step between, as multiples of real
+ * time. 0 stands for as fast as the host can go. */
+static const double SPEEDS[] = {0.25, 0.5, 1, 2, 4, 8, 16, 0};
+#define SPEED_COUNT (sizeof SPEEDS / sizeof *SPEEDS)
+
+/* The most often a changed frame is shown, once the emulator runs faster
+ * than real time: a typical display's refresh rate. */
+static const uint64_t PRESENT_INTERVAL_NS = 1000000000u / 60;
+
+/* How far behind its schedule the emulator may fall, when the host cannot
+ * keep up, before it gives up on catching up. */
+static const uint64_t MAX_LAG_NS = 100000000u;
+
+/* Return `speed` changed by `command`. */
+static double change_speed(double speed, enum Port_command command) {
+    size_t i;
+
+    switch (command) {
+        case PORT_COMMAND_SLOWER:
+            /* The fastest speed below the current one. */
+            for (i = SPEED_COUNT - 1; i > 0; i--) {
+                if (SPEEDS[i - 1] != 0
+                    && (speed == 0 || SPEEDS[i - 1] < speed)) {
+                    return SPEEDS[i - 1];
+                }
+            }
+            return speed;
+        case PORT_COMMAND_FASTER:
+            /* The slowest speed above the current one. */
+            if (speed == 0) {
+                return speed;
+            }
+            for (i = 0; i < SPEED_COUNT; i++) {
+                if (SPEEDS[i] == 0 || SPEEDS[i] > speed) {
+                    return SPEEDS[i];
+                }
+            }
+            return speed;
+        case PORT_COMMAND_NORMAL_SPEED:
+            return 1;
+        default:
+            return speed;
+    }
+}
+
+/* Show the current frame of `chip8`, keeping `telemetry` unless it is NULL.
+ * Return how long it took in nanoseconds. */
+static uint64_t present(struct Chip8 *chip8, struct telemetry *telemetry) {
+    uint64_t start_ns = Stats_now_ns();
+    uint64_t end_ns;
+    uint16_t width, height;
+    const uint64_t *display = Chip8_framebuffer(chip8, &width, &height);
+
+    Port_clear_screen();
+    Port_display_screen(display, width, height);
+    end_ns = Stats_now_ns();
+
+    if (telemetry) {
+        struct Stats *stats = &telemetry->stats;
+
+        stats->displayed_frame_count++;
+        Histogram_record(&stats->histograms[STATS_DISPLAY_NS],
+                         end_ns - start_ns);
+        if (telemetry->key_press_ns) {
+            Histogram_record(&stats->histograms[STATS_KEY_LATENCY_NS],
+                             Stats_now_ns() - telemetry->key_press_ns);
+            telemetry->key_press_ns = 0;
+        }
+    }
+
+    return end_ns - start_ns;
+}
+
+/* Rewrite the stats file of `telemetry` if it is due. */
+static void save_stats(struct telemetry *telemetry) {
+    uint64_t now_ns = Stats_now_ns();
+
+    if (now_ns >= telemetry->next_save_ns) {
+        Stats_save(&telemetry->stats, telemetry->file_name);
+        telemetry->next_save_ns = now_ns + STATS_SAVE_INTERVAL_NS;
+    }
+}
+
+/* Delay for `ms` milliseconds, keeping `telemetry` unless it is NULL. */
+static void delay(uint16_t ms, struct telemetry *telemetry) {
+    uint64_t start_ns, elapsed_ns;
+
+    if (!telemetry) {
+        Port_delay(ms);
+        return;
+    }
+
+    start_ns = Stats_now_ns();
+    Port_delay(ms);
+    elapsed_ns = Stats_now_ns() - start_ns;
+    Histogram_record(&telemetry->stats.histograms[STATS_DELAY_OVERSHOOT_NS],
+                     elapsed_ns > ms * 1000000u
+                     ? elapsed_ns - ms * 1000000u : 0);
+}
+
+/* Drive `chip8` until the application exits or the user quits, showing
+ * frames and reading keys through the port, recording each frame to
+ * `capture` and keeping `telemetry` unless either is NULL. Frames run at
+ * `speed` times real time (see SPEEDS), which the speed commands change.
+ * Every frame is run, so the timers count down once per emulated frame
+ * whatever the speed; but above real time, changed frames are only shown as
+ * often as the display refreshes and its cost allows.
+ * Return TRUE if the application exited cleanly. */
+static enum bool run(struct Chip8 *chip8, double speed,
+                     struct Capture *capture, struct telemetry *telemetry) {
+    const uint64_t frame_ns = 1000000000u * (uint64_t) CYCLES_PER_DELAY
+                              / CYCLES_PER_SECOND;
+    uint64_t next_frame_ns = Stats_now_ns();
+    uint64_t next_present_ns = next_frame_ns;
+    /* Whether a changed frame has not been shown yet. */
+    enum bool pending = FALSE;
+
+    while (!Port_quit_requested()) {
+        uint64_t cycle_count = Chip8_cycle_count(chip8);
+        enum Port_command command;
+        uint16_t held_keys = 0;
+        enum bool draw;
+        uint64_t now_ns;
+        uint8_t key;
+
+        Port_poll_input();
+        for (key = 0; key < 16; key++) {
+            enum bool pressed = Port_is_pressed(key);
+
+            Chip8_set_key(chip8, key, pressed);
+            held_keys |= (uint16_t) (pressed << key);
+        }
+        if (telemetry) {
+            note_keys(telemetry, held_keys);
+        }
+        while ((command = Port_next_command()) != PORT_COMMAND_NONE) {
+            speed = change_speed(speed, command);
+            next_frame_ns = Stats_now_ns();
+        }
+
+        if (!Chip8_run_frame(chip8, &draw)) {
+            /* Invalid execution or bad CPU state, kill the emulator. */
+            return FALSE;
+        }
+        if (capture) {
+            Capture_frame(capture, chip8);
+        }
+        if (telemetry) {
+            struct Stats *stats = &telemetry->stats;
+
+            cycle_count = Chip8_cycle_count(chip8) - cycle_count;
+            stats->frame_count++;
+            stats->cycle_count += cycle_count;
+            stats->dropped_sample_count = Chip8_dropped_samples(chip8);
+            Histogram_record(&stats->histograms[STATS_FRAME_CYCLES],
+                             cycle_count);
+            if (draw && pending) {
+                stats->skipped_frame_count++;
+            }
+        }
+        pending = pending || draw;
+
+        /* Up to real time every changed frame is shown. Beyond it, a frame
+         * is shown once a refresh has passed since the last, and only half
+         * the time goes to showing frames if that takes longer. */
+        now_ns = Stats_now_ns();
+        if (pending && ((speed != 0 && speed <= 1) || now_ns >= next_present_ns
+                        || Chip8_is_halted(chip8))) {
+            uint64_t present_ns = present(chip8, telemetry);
+
+            next_present_ns = now_ns + (2 * present_ns > PRESENT_INTERVAL_NS
+                                        ? 2 * present_ns
+                                        : PRESENT_INTERVAL_NS);
+            pending = FALSE;
+        }
+
+        if (Chip8_is_halted(chip8)) {
+            /* The application exited on its own. */
+            return TRUE;
+        }
+
+        if (telemetry) {
+            save_stats(telemetry);
+        }
+
+        /* Frames keep to a schedule rather than each waiting a fixed time,
+         * so that the time taken to run and show them does not slow the
+         * emulator down. */
+        if (speed != 0) {
+            next_frame_ns += (uint64_t) ((double) frame_ns / speed);
+            now_ns = Stats_now_ns();
+            if (next_frame_ns > now_ns) {
+                delay((uint16_t) ((next_frame_ns - now_ns) / 1000000u),
+                      telemetry);
+            }
+            else if (now_ns - next_frame_ns > MAX_LAG_NS) {
+                next_frame_ns = now_ns;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+/* Emulate the CHIP-8 system, loading in a ROM from the file specified by the
+ * last command line argument. The `-s` and `-x` options select the
+ * SUPER-CHIP and XO-CHIP instruction sets respectively, and `-v` shifts VY
+ * into VX on 8XY6 and 8XYE as the COSMAC VIP did. The `-a` option
+ * prints the ROM's control-flow graph instead of running it, `-o` sends the
+ * sound to an audio file (see Audio_open_sink), and `-t` keeps telemetry on
+ * the run, rewriting the given stats file with it every second and printing
+ * it at exit. `-c` records every frame to a capture file for chip8_frames.
+ * `-f` sets the speed as a multiple of real time, at least
+ * 0.25, or `max` for as fast as possible; `-` and `=` step it down and up
+ * while running, and `0` puts it back to real time. When built with
+ * CHIP8_RECOMPILED, the ROM and instruction set are instead those of the
+ * translated application linked in. */
+int main(int argc, char *argv[]) {
+    enum Chip8_mode mode = MODE_CHIP8;
+    enum bool analyse = FALSE;
+    enum bool vip_shifts = FALSE;
+    const char *audio_file_name = NULL;
+    const char *capture_file_name = NULL;
+    const char *stats_file_name = NULL;
+    struct telemetry telemetry;
+    double speed = 1;
+    enum bool usage = FALSE;
+    char *rest;
+    struct Audio_sink sink;
+    struct Audio audio;
+    struct Capture capture;
+    enum bool success;
+    struct Chip8 *chip8;
+    int option;
+
+    while ((option = getopt(argc, argv, "ac:f:o:st:vx")) != -1) {
+        switch (option) {
+            case 'a':
+                analyse = TRUE;
+                break;
+            case 'c':
+                capture_file_name = optarg;
+                break;
+            case 'f':
+                if (strcmp(optarg, "max") == 0) {
+                    speed = 0;
+                    break;
+                }
+                speed = strtod(optarg, &rest);
+                if (*rest != '\0' || !(speed >= 0.25)) {
+                    usage = TRUE;
+                }
+                break;
+            case 'o':
+                audio_file_name = optarg;
+                break;
+            case 's':
+                mode = MODE_SCHIP;
+                break;
+            case 'v':
+                vip_shifts = TRUE;
+                break;
+            case 't':
+                stats_file_name = optarg;
+                break;
+            case 'x':
+                mode = MODE_XOCHIP;
+                break;
+            default:
+                usage = TRUE;
+                break;
+        }
+    }
+
+#ifdef CHIP8_RECOMPILED
+    if (usage || optind != argc) {
+        fprintf(stderr, "Usage: %s [-a] [-c <capture_file>] "
+                        "[-f <speed> | -f max] "
+                        "[-o <audio_file>] [-t <stats_file>] [-v]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    chip8 = Chip8_create(RECOMPILED_PROGRAM.mode);
+    if (!chip8) {
+        return EXIT_FAILURE;
+    }
+    if (!Chip8_load_rom(chip8, RECOMPILED_PROGRAM.rom,
+                        RECOMPILED_PROGRAM.rom_size)
+        || !Chip8_use_program(chip8, &RECOMPILED_PROGRAM)) {
+        Chip8_destroy(chip8);
+        return EXIT_FAILURE;
+    }
+    (void) mode;
+#else
+    if (usage || optind != argc - 1) {
+        fprintf(stderr, "Usage: %s [-a] [-c <capture_file>] "
+                        "[-f <speed> | -f max] "
+                        "[-o <audio_file>] [-t <stats_file>] [-v] [-s | -x] "
+                        "<rom_file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    chip8 = Chip8_create(mode);
+    if (!chip8) {
+        return EXIT_FAILURE;
+    }
+    if (!Chip8_load_rom_file(chip8, argv[optind])) {
+        Chip8_destroy(chip8);
+        return EXIT_FAILURE;
+    }
+#endif
+    if (vip_shifts) {
+        Chip8_add_quirks(chip8, QUIRK_SHIFT_FROM_VY);
+    }
+
+    if (analyse) {
+        Chip8_print_analysis(chip8, stdout);
+        Chip8_destroy(chip8);
+        return EXIT_SUCCESS;
+    }
+
+    /* The sound is written out on a thread of its own, so that a slow sink
+     * never holds up the emulator. */
+    if (audio_file_name) {
+        if (!Audio_open_sink(&sink, audio_file_name)) {
+            Chip8_destroy(chip8);
+            return EXIT_FAILURE;
+        }
+        if (!Audio_start(&audio, &sink)) {
+            Chip8_destroy(chip8);
+            return EXIT_FAILURE;
+        }
+        Chip8_set_audio(chip8, &audio.ring);
+    }
+    /* As is the capture, recording from the power on frame. */
+    if (capture_file_name) {
+        if (!Capture_start(&capture, capture_file_name)) {
+            if (audio_file_name) {
+                Audio_stop(&audio);
+            }
+            Chip8_destroy(chip8);
+            return EXIT_FAILURE;
+        }
+        Capture_frame(&capture, chip8);
+    }
+
+    if (!Port_init()) {
+        if (capture_file_name) {
+            Capture_stop(&capture);
+        }
+        if (audio_file_name) {
+            Audio_stop(&audio);
+        }
+        Chip8_destroy(chip8);
+        return EXIT_FAILURE;
+    }
+    if (stats_file_name) {
+        memset(&telemetry, 0, sizeof telemetry);
+        Stats_init(&telemetry.stats);
+        telemetry.file_name = stats_file_name;
+    }
+    success = run(chip8, speed, capture_file_name ? &capture : NULL,
+                  stats_file_name ? &telemetry : NULL);
+    Port_uninit();
+
+    /* The final stats go to the stats file and, now that the terminal is
+     * back to normal, to the user. */
+    if (stats_file_name) {
+        if (!Stats_save(&telemetry.stats, stats_file_name)) {
+            fprintf(stderr, "The stats file '%s' could not be written.\n",
+                    stats_file_name);
+        }
+        Stats_write(&telemetry.stats, stderr);
+    }
+
+    if (audio_file_name) {
+        Chip8_set_audio(chip8, NULL);
+        success = Audio_stop(&audio) && success ? TRUE : FALSE;
+    }
+    if (capture_file_name) {
+        if (capture.dropped_frame_count) {
+            fprintf(stderr, "%llu frames could not be captured.\n",
+                    (unsigned long long) capture.dropped_frame_count);
+        }
+        success = Capture_stop(&capture) && success ? TRUE : FALSE;
+    }
+    Chip8_destroy(chip8);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
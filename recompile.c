@@ -0,0 +1,477 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "analysis.h"
+#include "constant.h"
+#include "image.h"
+
+static const char *const MODE_NAMES[] = {
+    "MODE_CHIP8", "MODE_SCHIP", "MODE_XOCHIP"
+};
+
+/* The number of ROM bytes written on each line of the generated source. */
+static const int BYTES_PER_LINE = 12;
+
+/* Return TRUE iff. `op` is a skip, whose condition the translation tests
+ * itself. */
+static enum bool is_skip(uint8_t op)
+{
+    return op == OP_SKIP_EQUAL_IMMEDIATE || op == OP_SKIP_NOT_EQUAL_IMMEDIATE
+           || op == OP_SKIP_EQUAL || op == OP_SKIP_NOT_EQUAL
+           || op == OP_SKIP_PRESSED || op == OP_SKIP_NOT_PRESSED
+           ? TRUE : FALSE;
+}
+
+/* Return TRUE iff. `op` is executed by calling the interpreter rather than
+ * being translated. These are either rare, or dominated by the work done
+ * in the screen or memory rather than by decoding. */
+static enum bool is_interpreted(uint8_t op)
+{
+    switch (op) {
+        case OP_CLEAR:
+        case OP_RETURN:
+        case OP_JUMP:
+        case OP_CALL:
+        case OP_SET_IMMEDIATE:
+        case OP_ADD_IMMEDIATE:
+        case OP_SET:
+        case OP_OR:
+        case OP_AND:
+        case OP_XOR:
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_SHIFT_RIGHT:
+        case OP_SUBTRACT_REVERSE:
+        case OP_SHIFT_LEFT:
+        case OP_SET_I:
+        case OP_JUMP_OFFSET:
+        case OP_GET_DELAY:
+        case OP_SET_DELAY:
+        case OP_SET_SOUND:
+        case OP_ADD_I:
+            return FALSE;
+        default:
+            return is_skip(op) ? FALSE : TRUE;
+    }
+}
+
+/* Return TRUE iff. the interpreted `op` may change the display. */
+static enum bool may_draw(uint8_t op)
+{
+    return op == OP_DRAW || op == OP_SCROLL_DOWN || op == OP_SCROLL_UP
+           || op == OP_SCROLL_LEFT || op == OP_SCROLL_RIGHT
+           || op == OP_LORES || op == OP_HIRES
+           ? TRUE : FALSE;
+}
+
+/* Return TRUE iff. the interpreted `op` writes to memory. */
+static enum bool writes_memory(uint8_t op)
+{
+    return op == OP_DECIMAL || op == OP_STORE || op == OP_SAVE_RANGE
+           ? TRUE : FALSE;
+}
+
+/* Write the condition under which the skip `op` skips. */
+static void write_skip_condition(FILE *out, uint8_t op, uint16_t opcode)
+{
+    unsigned int x = (opcode >> 8) & 0xFu;
+    unsigned int y = (opcode >> 4) & 0xFu;
+    unsigned int nn = opcode & 0xFFu;
+
+    switch (op) {
+        case OP_SKIP_EQUAL_IMMEDIATE:
+            fprintf(out, "V[0x%X] == 0x%02X", x, nn);
+            break;
+        case OP_SKIP_NOT_EQUAL_IMMEDIATE:
+            fprintf(out, "V[0x%X] != 0x%02X", x, nn);
+            break;
+        case OP_SKIP_EQUAL:
+            fprintf(out, "V[0x%X] == V[0x%X]", x, y);
+            break;
+        case OP_SKIP_NOT_EQUAL:
+            fprintf(out, "V[0x%X] != V[0x%X]", x, y);
+            break;
+        case OP_SKIP_PRESSED:
+            fprintf(out, "Inp_is_pressed(cpu->input, V[0x%X])", x);
+            break;
+        case OP_SKIP_NOT_PRESSED:
+            fprintf(out, "!Inp_is_pressed(cpu->input, V[0x%X])", x);
+            break;
+    }
+}
+
+/* Write the statements for the translated (not interpreted) instruction
+ * `opcode`, the `index`th of its block, at `address`. Return TRUE iff.
+ * they end the block by returning. */
+static enum bool write_translation(FILE *out, enum Chip8_mode mode,
+                                   uint32_t memory_size, uint8_t op,
+                                   uint16_t opcode, uint16_t address,
+                                   unsigned int index)
+{
+    unsigned int x = (opcode >> 8) & 0xFu;
+    unsigned int y = (opcode >> 4) & 0xFu;
+    unsigned int nn = opcode & 0xFFu;
+    unsigned int nnn = opcode & 0xFFFu;
+    unsigned int next = address + 2u;
+
+    if (is_skip(op)) {
+        /* Skips must jump over all of an XO-CHIP F000 NNNN, which
+         * depends on the memory after the skip. */
+        fprintf(out, "    cpu->program_counter = ");
+        write_skip_condition(out, op, opcode);
+        if (mode == MODE_XOCHIP && next + 1u < memory_size) {
+            fprintf(out, "\n        ? (cpu->memory[0x%04X] == 0xF0 "
+                         "&& cpu->memory[0x%04X] == 0x00 ? 0x%04X : 0x%04X)"
+                         "\n        : 0x%04X;\n",
+                    next, next + 1u, next + 4u, next + 2u, next);
+        }
+        else {
+            fprintf(out, " ? 0x%04X : 0x%04X;\n", next + 2u, next);
+        }
+        fprintf(out, "    return %u;\n", index + 1);
+        return TRUE;
+    }
+
+    switch (op) {
+        case OP_CLEAR:
+            fprintf(out, "    Screen_clear(cpu->screen);\n"
+                         "    *invalidate_display = TRUE;\n");
+            return FALSE;
+
+        case OP_RETURN:
+            /* Fail on a stack underflow, as the interpreter does. */
+            fprintf(out, "    if (cpu->stack_pointer <= 0) {\n"
+                         "        cpu->program_counter = 0x%04X;\n"
+                         "        fprintf(stderr, \"Stack underflow at "
+                         "%03x\\n\");\n"
+                         "        return -1;\n"
+                         "    }\n"
+                         "    cpu->stack_pointer--;\n"
+                         "    cpu->program_counter = "
+                         "cpu->stack[cpu->stack_pointer] + 2;\n"
+                         "    return %u;\n",
+                    address, address, index + 1);
+            return TRUE;
+
+        case OP_JUMP:
+            fprintf(out, "    cpu->program_counter = 0x%04X;\n"
+                         "    return %u;\n", nnn, index + 1);
+            return TRUE;
+
+        case OP_CALL:
+            /* As above, for a stack overflow. */
+            fprintf(out, "    if (cpu->stack_pointer >= cpu->stack_size) {\n"
+                         "        cpu->program_counter = 0x%04X;\n"
+                         "        fprintf(stderr, \"Stack overflow at "
+                         "%03x\\n\");\n"
+                         "        return -1;\n"
+                         "    }\n"
+                         "    cpu->stack[cpu->stack_pointer++] = 0x%04X;\n"
+                         "    cpu->program_counter = 0x%04X;\n"
+                         "    return %u;\n",
+                    address, address, address, nnn, index + 1);
+            return TRUE;
+
+        case OP_SET_IMMEDIATE:
+            fprintf(out, "    V[0x%X] = 0x%02X;\n", x, nn);
+            return FALSE;
+
+        case OP_ADD_IMMEDIATE:
+            fprintf(out, "    V[0x%X] += 0x%02X;\n", x, nn);
+            return FALSE;
+
+        case OP_SET:
+            fprintf(out, "    V[0x%X] = V[0x%X];\n", x, y);
+            return FALSE;
+
+        case OP_OR:
+            fprintf(out, "    V[0x%X] |= V[0x%X];\n", x, y);
+            return FALSE;
+
+        case OP_AND:
+            fprintf(out, "    V[0x%X] &= V[0x%X];\n", x, y);
+            return FALSE;
+
+        case OP_XOR:
+            fprintf(out, "    V[0x%X] ^= V[0x%X];\n", x, y);
+            return FALSE;
+
+        case OP_ADD:
+            fprintf(out, "    V[0x%X] += V[0x%X];\n"
+                         "    V[0xF] = V[0x%X] < V[0x%X];\n", x, y, x, y);
+            return FALSE;
+
+        case OP_SUBTRACT:
+            fprintf(out, "    V[0xF] = V[0x%X] > V[0x%X];\n"
+                         "    V[0x%X] -= V[0x%X];\n", x, y, x, y);
+            return FALSE;
+
+        case OP_SUBTRACT_REVERSE:
+            fprintf(out, "    V[0xF] = V[0x%X] > V[0x%X];\n"
+                         "    V[0x%X] = V[0x%X] - V[0x%X];\n",
+                    y, x, x, y, x);
+            return FALSE;
+
+        case OP_SHIFT_RIGHT:
+        case OP_SHIFT_LEFT:
+            fprintf(out, "    if (cpu->quirks & QUIRK_SHIFT_FROM_VY) {\n"
+                         "        V[0x%X] = V[0x%X];\n"
+                         "    }\n", x, y);
+            if (op == OP_SHIFT_RIGHT) {
+                fprintf(out, "    V[0xF] = V[0x%X] & 1;\n"
+                             "    V[0x%X] >>= 1;\n", x, x);
+            }
+            else {
+                fprintf(out, "    V[0xF] = (V[0x%X] & 0x80) != 0;\n"
+                             "    V[0x%X] <<= 1;\n", x, x);
+            }
+            return FALSE;
+
+        case OP_SET_I:
+            fprintf(out, "    cpu->I = 0x%03X;\n", nnn);
+            return FALSE;
+
+        case OP_JUMP_OFFSET:
+            fprintf(out, "    cpu->program_counter = 0x%03X\n"
+                         "        + (cpu->quirks & QUIRK_JUMP_VX ? V[0x%X] "
+                         ": V[0x0]);\n"
+                         "    return %u;\n", nnn, x, index + 1);
+            return TRUE;
+
+        case OP_GET_DELAY:
+            fprintf(out, "    V[0x%X] = cpu->delay_timer;\n", x);
+            return FALSE;
+
+        case OP_SET_DELAY:
+            fprintf(out, "    cpu->delay_timer = V[0x%X];\n", x);
+            return FALSE;
+
+        case OP_SET_SOUND:
+            fprintf(out, "    cpu->sound_timer = V[0x%X];\n", x);
+            return FALSE;
+
+        case OP_ADD_I:
+            fprintf(out, "    cpu->I += V[0x%X];\n", x);
+            return FALSE;
+    }
+
+    return FALSE;
+}
+
+/* Write the function translating `block`. Blocks whose code the analysis
+ * cannot prove is never overwritten check that it is intact first. */
+static void write_block(FILE *out, const struct Analysis *analysis,
+                        const struct Analysis_block *block,
+                        const uint8_t *memory, enum Chip8_mode mode)
+{
+    enum bool guarded = !analysis->complete
+                        || (block->flags & BLOCK_SELF_MODIFYING);
+    enum bool returned = FALSE;
+    unsigned int index = 0;
+    uint32_t address;
+
+    fprintf(out, "\nstatic int block_%04X(struct Cpu *cpu, int budget,\n"
+                 "                      enum bool *invalidate_display)\n"
+                 "{\n"
+                 "    uint8_t *V = cpu->register_v;\n"
+                 "    enum bool drawn;\n"
+                 "\n"
+                 "    (void) V;\n"
+                 "    (void) drawn;\n"
+                 "    (void) budget;\n"
+                 "    (void) invalidate_display;\n",
+            block->start);
+    if (guarded) {
+        fprintf(out, "    if (memcmp(cpu->memory + 0x%04X, ROM + 0x%04X, %u) "
+                     "!= 0) {\n"
+                     "        return 0;\n"
+                     "    }\n",
+                block->start, block->start - APPLICATION_START,
+                (unsigned int) (block->end - block->start));
+    }
+
+    for (address = block->start; address < block->end && !returned;
+         index++) {
+        uint8_t op = analysis->ops[address];
+        uint16_t opcode = (uint16_t) (memory[address] << 8
+                                      | memory[address + 1]);
+        uint32_t next = address + (op == OP_SET_I_LONG ? 4 : 2);
+
+        fprintf(out, "\n    /* %04X: %04X */\n", address, opcode);
+        if (index > 0) {
+            /* Stop where the frame ends. */
+            fprintf(out, "    if (budget == %u) {\n"
+                         "        cpu->program_counter = 0x%04X;\n"
+                         "        return %u;\n"
+                         "    }\n", index, address, index);
+        }
+
+        if (is_interpreted(op)) {
+            fprintf(out, "    cpu->program_counter = 0x%04X;\n"
+                         "    if (!Cpu_cycle(cpu, &drawn)) {\n"
+                         "        return -1;\n"
+                         "    }\n", address);
+            if (may_draw(op)) {
+                fprintf(out, "    *invalidate_display = "
+                             "*invalidate_display || drawn;\n");
+            }
+
+            /* The rest of the block may have just been overwritten. */
+            if (guarded && writes_memory(op)) {
+                fprintf(out, "    return %u;\n", index + 1);
+                returned = TRUE;
+            }
+            else if (next < block->end) {
+                /* The interpreter went somewhere else, e.g. FX0A is
+                 * still waiting for a key. */
+                fprintf(out, "    if (cpu->program_counter != 0x%04X) {\n"
+                             "        return %u;\n"
+                             "    }\n", (unsigned int) next, index + 1);
+            }
+            else {
+                fprintf(out, "    return %u;\n", index + 1);
+                returned = TRUE;
+            }
+        }
+        else {
+            returned = write_translation(out, mode, analysis->memory_size,
+                                         op, opcode, (uint16_t) address,
+                                         index);
+        }
+
+        address = next;
+    }
+
+    /* Execution runs on into the following block. */
+    if (!returned) {
+        fprintf(out, "    cpu->program_counter = 0x%04X;\n"
+                     "    return %u;\n", (unsigned int) block->end, index);
+    }
+    fprintf(out, "}\n");
+}
+
+/* Write C source translating the application in `image` to `out`. */
+static void write_program(FILE *out, const struct Analysis *analysis,
+                          const struct Image *image, enum Chip8_mode mode,
+                          const char *rom_file_name)
+{
+    const uint8_t *rom = image->data + APPLICATION_START;
+    uint32_t rom_end = APPLICATION_START + (uint32_t) image->rom_size;
+    unsigned int block_count = 0;
+    size_t i;
+
+    fprintf(out, "/* Generated by chip8_recompile from %s. Do not edit. */\n"
+                 "\n"
+                 "#include <stdint.h>\n"
+                 "#include <stdio.h>\n"
+                 "#include <string.h>\n"
+                 "\n"
+                 "#include \"cpu.h\"\n"
+                 "#include \"input.h\"\n"
+                 "#include \"recompiled.h\"\n"
+                 "#include \"screen.h\"\n"
+                 "\n"
+                 "static const uint8_t ROM[] = {", rom_file_name);
+    for (i = 0; i < image->rom_size; i++) {
+        fprintf(out, "%s0x%02X%s", i % BYTES_PER_LINE ? " " : "\n    ",
+                rom[i], i + 1 < image->rom_size ? "," : "");
+    }
+    fprintf(out, "\n};\n");
+
+    /* Only code loaded from the ROM is translated; code elsewhere, in the
+     * interpreter data or built at run time, is left to the interpreter. */
+    for (i = 0; i < analysis->block_count; i++) {
+        const struct Analysis_block *block = &analysis->blocks[i];
+
+        if (block->start >= APPLICATION_START && block->end <= rom_end) {
+            write_block(out, analysis, block, image->data, mode);
+            block_count++;
+        }
+    }
+
+    fprintf(out, "\nstatic const struct Recompiled_block BLOCKS[] = {\n");
+    for (i = 0; i < analysis->block_count; i++) {
+        const struct Analysis_block *block = &analysis->blocks[i];
+
+        if (block->start >= APPLICATION_START && block->end <= rom_end) {
+            fprintf(out, "    {0x%04X, block_%04X},\n",
+                    block->start, block->start);
+        }
+    }
+    if (block_count == 0) {
+        fprintf(out, "    {0, NULL}\n");
+    }
+    fprintf(out, "};\n"
+                 "\n"
+                 "const struct Recompiled_program RECOMPILED_PROGRAM = {\n"
+                 "    %s, ROM, sizeof ROM, BLOCKS, %u\n"
+                 "};\n", MODE_NAMES[mode], block_count);
+}
+
+/* Translate the ROM in the file given by the first argument into C source,
+ * one function per basic block of its control-flow graph, written to the
+ * file given by the second. `-s` and `-x` select the SUPER-CHIP and XO-CHIP
+ * instruction sets. Compiled and linked against libchip8, the source
+ * defines RECOMPILED_PROGRAM for Chip8_use_program. */
+int main(int argc, char *argv[]) {
+    enum Chip8_mode mode = MODE_CHIP8;
+    struct Analysis analysis;
+    struct Image *image;
+    int option;
+    FILE *out;
+
+    while ((option = getopt(argc, argv, "sx")) != -1) {
+        switch (option) {
+            case 's':
+                mode = MODE_SCHIP;
+                break;
+            case 'x':
+                mode = MODE_XOCHIP;
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+
+    if (optind != argc - 2) {
+        fprintf(stderr, "Usage: %s [-s | -x] <rom_file> <c_file>\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    image = Image_open(argv[optind],
+                       mode == MODE_XOCHIP ? XOCHIP_MEMORY_SIZE : MEMORY_SIZE);
+    if (!image) {
+        return EXIT_FAILURE;
+    }
+    if (!Analysis_run(&analysis, image->data, image->memory_size, mode)) {
+        Image_release(image);
+        return EXIT_FAILURE;
+    }
+
+    out = fopen(argv[optind + 1], "w");
+    if (!out) {
+        fprintf(stderr, "The file '%s' could not be written.\n",
+                argv[optind + 1]);
+        Analysis_free(&analysis);
+        Image_release(image);
+        return EXIT_FAILURE;
+    }
+    write_program(out, &analysis, image, mode, argv[optind]);
+
+    if (fclose(out) != 0) {
+        fprintf(stderr, "The file '%s' could not be written.\n",
+                argv[optind + 1]);
+        Analysis_free(&analysis);
+        Image_release(image);
+        return EXIT_FAILURE;
+    }
+
+    Analysis_free(&analysis);
+    Image_release(image);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,313 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "replay.h"
+
+/* The longest path or manifest line that is read. */
+#define PATH_SIZE 4096
+
+/* The seed every ROM is run with, the same as chip8_headless's default, so
+ * that hashes can be produced with either tool. */
+static const uint64_t SEED = 1;
+
+static const char *const MODE_NAMES[] = {"chip8", "schip", "xochip"};
+
+enum result {RESULT_PASS, RESULT_FAIL, RESULT_ERROR};
+
+/* One line of the manifest and the outcome of running it. */
+struct entry {
+    /* The ROM and input script as written in the manifest, and resolved
+     * against the manifest's directory. The script is optional. */
+    char rom_name[PATH_SIZE];
+    char script_name[PATH_SIZE];
+    char rom_path[PATH_SIZE];
+    char script_path[PATH_SIZE];
+    enum Chip8_mode mode;
+    uint32_t frame_count;
+    uint64_t expected_hash;
+
+    uint64_t hash;
+    enum result result;
+};
+
+/* The entries shared between the worker threads, which take the next one
+ * to run under the lock. */
+struct corpus {
+    struct entry *entries;
+    size_t entry_count;
+    size_t next_entry;
+    pthread_mutex_t lock;
+};
+
+/* Store `name` in `path`, relative to the directory of the manifest at
+ * `manifest_file_name` unless it is absolute. Return TRUE on success. */
+static enum bool resolve(char *path, const char *manifest_file_name,
+                         const char *name) {
+    const char *slash = strrchr(manifest_file_name, '/');
+    int directory_length = slash ? (int) (slash - manifest_file_name + 1) : 0;
+
+    if (name[0] == '/') {
+        directory_length = 0;
+    }
+    return snprintf(path, PATH_SIZE, "%.*s%s", directory_length,
+                    manifest_file_name, name) < PATH_SIZE ? TRUE : FALSE;
+}
+
+/* Parse manifest `line` into `entry`. Return TRUE on success and FALSE on
+ * error. */
+static enum bool parse_entry(const char *line, const char *manifest_file_name,
+                             struct entry *entry) {
+    char mode_name[16];
+    unsigned long frame_count;
+    unsigned long long expected_hash;
+    int field_count;
+    size_t mode;
+
+    memset(entry, 0, sizeof *entry);
+    field_count = sscanf(line, "%4095s %15s %lu %llx %4095s", entry->rom_name,
+                         mode_name, &frame_count, &expected_hash,
+                         entry->script_name);
+    if (field_count < 4) {
+        return FALSE;
+    }
+
+    for (mode = 0; mode < sizeof MODE_NAMES / sizeof *MODE_NAMES; mode++) {
+        if (strcmp(mode_name, MODE_NAMES[mode]) == 0) {
+            break;
+        }
+    }
+    if (mode == sizeof MODE_NAMES / sizeof *MODE_NAMES) {
+        return FALSE;
+    }
+
+    entry->mode = (enum Chip8_mode) mode;
+    entry->frame_count = (uint32_t) frame_count;
+    entry->expected_hash = expected_hash;
+    if (!resolve(entry->rom_path, manifest_file_name, entry->rom_name)) {
+        return FALSE;
+    }
+    if (field_count == 5
+        && !resolve(entry->script_path, manifest_file_name,
+                    entry->script_name)) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Read the manifest in `file_name` into `corpus`. Return TRUE on success
+ * and FALSE on error. */
+static enum bool load_manifest(struct corpus *corpus, const char *file_name) {
+    char line[PATH_SIZE];
+    size_t capacity = 0;
+    unsigned int line_number = 0;
+    FILE *file;
+
+    file = fopen(file_name, "r");
+    if (!file) {
+        fprintf(stderr, "The manifest '%s' could not be opened.\n",
+                file_name);
+        return FALSE;
+    }
+
+    while (fgets(line, sizeof line, file)) {
+        const char *start = line + strspn(line, " \t");
+
+        line_number++;
+        if (*start == '#' || *start == '\n' || *start == '\0') {
+            continue;
+        }
+
+        if (corpus->entry_count == capacity) {
+            size_t new_capacity = capacity ? 2 * capacity : 16;
+            struct entry *entries = realloc(corpus->entries,
+                                            new_capacity * sizeof *entries);
+
+            if (!entries) {
+                fclose(file);
+                return FALSE;
+            }
+            corpus->entries = entries;
+            capacity = new_capacity;
+        }
+
+        if (!parse_entry(start, file_name,
+                         &corpus->entries[corpus->entry_count])) {
+            fprintf(stderr, "%s:%u: expected '<rom_file> chip8|schip|xochip "
+                            "<frames> <hash> [<input_script>]'.\n",
+                    file_name, line_number);
+            fclose(file);
+            return FALSE;
+        }
+        corpus->entry_count++;
+    }
+
+    fclose(file);
+    return TRUE;
+}
+
+/* Run the ROM of `entry` and record the hash of its last frame. */
+static void run_entry(struct entry *entry) {
+    struct Replay_script script;
+    struct Chip8 *chip8;
+    uint32_t frame = 0;
+
+    entry->result = RESULT_ERROR;
+    if (!Replay_load_script(&script, entry->script_path[0]
+                                     ? entry->script_path : NULL)) {
+        return;
+    }
+    chip8 = Chip8_create(entry->mode);
+    if (!chip8) {
+        Replay_free_script(&script);
+        return;
+    }
+
+    if (Chip8_load_rom_file(chip8, entry->rom_path)) {
+        Chip8_seed(chip8, SEED);
+        if (Replay_run(chip8, &script, &frame, entry->frame_count)) {
+            entry->hash = Replay_hash_frame(chip8);
+            entry->result = entry->hash == entry->expected_hash
+                            ? RESULT_PASS : RESULT_FAIL;
+        }
+    }
+
+    Chip8_destroy(chip8);
+    Replay_free_script(&script);
+}
+
+/* Worker thread: run entries until there are none left. */
+static void *run_entries(void *argument) {
+    struct corpus *corpus = argument;
+
+    for (;;) {
+        size_t index;
+
+        pthread_mutex_lock(&corpus->lock);
+        index = corpus->next_entry++;
+        pthread_mutex_unlock(&corpus->lock);
+
+        if (index >= corpus->entry_count) {
+            return NULL;
+        }
+        run_entry(&corpus->entries[index]);
+    }
+}
+
+/* Run every ROM in the manifest in parallel and compare the hash of its
+ * last frame against the golden hash. `-j` sets the number of threads and
+ * `-u` prints the manifest with the hashes that were produced instead, for
+ * blessing a new set of golden hashes. */
+int main(int argc, char *argv[]) {
+    struct corpus corpus;
+    pthread_t *threads;
+    long thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    long started = 0;
+    enum bool update = FALSE;
+    size_t failures = 0;
+    size_t errors = 0;
+    size_t i;
+    int option;
+
+    while ((option = getopt(argc, argv, "j:u")) != -1) {
+        switch (option) {
+            case 'j':
+                thread_count = strtol(optarg, NULL, 10);
+                break;
+            case 'u':
+                update = TRUE;
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+
+    if (optind != argc - 1) {
+        fprintf(stderr, "Usage: %s [-j <threads>] [-u] <manifest>\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    memset(&corpus, 0, sizeof corpus);
+    if (!load_manifest(&corpus, argv[optind])) {
+        free(corpus.entries);
+        return EXIT_FAILURE;
+    }
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+    if ((size_t) thread_count > corpus.entry_count) {
+        thread_count = corpus.entry_count ? (long) corpus.entry_count : 1;
+    }
+
+    threads = malloc((size_t) thread_count * sizeof *threads);
+    if (!threads) {
+        free(corpus.entries);
+        return EXIT_FAILURE;
+    }
+    pthread_mutex_init(&corpus.lock, NULL);
+
+    /* Whatever threads do start pick up the whole corpus between them. */
+    while (started < thread_count
+           && pthread_create(&threads[started], NULL, run_entries,
+                             &corpus) == 0) {
+        started++;
+    }
+    if (started == 0) {
+        run_entries(&corpus);
+    }
+    while (started > 0) {
+        pthread_join(threads[--started], NULL);
+    }
+
+    for (i = 0; i < corpus.entry_count; i++) {
+        const struct entry *entry = &corpus.entries[i];
+
+        if (entry->result != RESULT_PASS) {
+            failures++;
+        }
+        if (entry->result == RESULT_ERROR) {
+            errors++;
+        }
+
+        if (update) {
+            printf("%s %s %lu %016llx%s%s\n", entry->rom_name,
+                   MODE_NAMES[entry->mode],
+                   (unsigned long) entry->frame_count,
+                   (unsigned long long) (entry->result == RESULT_ERROR
+                                         ? entry->expected_hash
+                                         : entry->hash),
+                   entry->script_name[0] ? " " : "", entry->script_name);
+        }
+        else if (entry->result == RESULT_PASS) {
+            printf("PASS  %s\n", entry->rom_name);
+        }
+        else if (entry->result == RESULT_FAIL) {
+            printf("FAIL  %s: expected %016llx, got %016llx\n",
+                   entry->rom_name,
+                   (unsigned long long) entry->expected_hash,
+                   (unsigned long long) entry->hash);
+        }
+        else {
+            printf("ERROR %s: could not be run\n", entry->rom_name);
+        }
+    }
+
+    if (!update) {
+        printf("%lu passed, %lu failed\n",
+               (unsigned long) (corpus.entry_count - failures),
+               (unsigned long) failures);
+    }
+
+    pthread_mutex_destroy(&corpus.lock);
+    free(threads);
+    free(corpus.entries);
+    /* When updating, only ROMs which could not be run at all fail. */
+    return (update ? errors : failures) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,314 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "constant.h"
+#include "hash.h"
+#include "replay.h"
+
+/* The longest script line that is read. */
+#define LINE_SIZE 256
+
+/* The framebuffer is hashed this many words at a time. */
+#define HASH_CHUNK_WORD_COUNT 64
+
+/* GIF image data comes in blocks of up to this many bytes. */
+#define GIF_BLOCK_SIZE 255
+
+/* The width of the LZW codes in GIF images written, the code which clears
+ * the code table, and how many pixels are written between clears to keep
+ * the codes that width. */
+#define GIF_CODE_BITS 8
+#define GIF_CLEAR_CODE (1 << (GIF_CODE_BITS - 1))
+#define GIF_CODES_PER_CLEAR (GIF_CLEAR_CODE - 2)
+
+/* -------------------------------------------------------------------------- */
+/* Private Interface -------------------------------------------------------- */
+
+/* Parse `line` into `event`. Return TRUE on success and FALSE on error. */
+static enum bool parse_event(const char *line, struct Replay_event *event)
+{
+    unsigned long frame;
+    unsigned int key_number;
+    char action[8];
+
+    if (sscanf(line, "%lu %x %7s", &frame, &key_number, action) != 3
+        || key_number > 0xF) {
+        return FALSE;
+    }
+
+    event->frame = (uint32_t) frame;
+    event->key_number = (uint8_t) key_number;
+    if (strcmp(action, "down") == 0) {
+        event->pressed = TRUE;
+    }
+    else if (strcmp(action, "up") == 0) {
+        event->pressed = FALSE;
+    }
+    else {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Append the byte `code` to the GIF image data being built in `block`,
+ * writing out the block when it fills up. Return FALSE on error. */
+static enum bool put_gif_code(FILE *file, uint8_t *block, uint8_t code)
+{
+    block[++block[0]] = code;
+    if (block[0] == GIF_BLOCK_SIZE) {
+        if (fwrite(block, 1, GIF_BLOCK_SIZE + 1, file) != GIF_BLOCK_SIZE + 1) {
+            return FALSE;
+        }
+        block[0] = 0;
+    }
+    return TRUE;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Public Interface --------------------------------------------------------- */
+
+enum bool Replay_load_script(struct Replay_script *script,
+                             const char *file_name)
+{
+    char line[LINE_SIZE];
+    size_t capacity = 0;
+    unsigned int line_number = 0;
+    FILE *file;
+
+    memset(script, 0, sizeof *script);
+    if (!file_name) {
+        return TRUE;
+    }
+
+    file = fopen(file_name, "r");
+    if (!file) {
+        fprintf(stderr, "The input script '%s' could not be opened.\n",
+                file_name);
+        return FALSE;
+    }
+
+    while (fgets(line, sizeof line, file)) {
+        const char *start = line + strspn(line, " \t");
+
+        line_number++;
+        if (*start == '#' || *start == '\n' || *start == '\0') {
+            continue;
+        }
+
+        if (script->event_count == capacity) {
+            size_t new_capacity = capacity ? 2 * capacity : 64;
+            struct Replay_event *events = realloc(
+                script->events, new_capacity * sizeof *events);
+
+            if (!events) {
+                Replay_free_script(script);
+                fclose(file);
+                return FALSE;
+            }
+            script->events = events;
+            capacity = new_capacity;
+        }
+
+        if (!parse_event(start, &script->events[script->event_count])
+            || (script->event_count > 0
+                && script->events[script->event_count].frame
+                   < script->events[script->event_count - 1].frame)) {
+            fprintf(stderr, "%s:%u: expected '<frame> <key> down|up' "
+                            "in frame order.\n", file_name, line_number);
+            Replay_free_script(script);
+            fclose(file);
+            return FALSE;
+        }
+        script->event_count++;
+    }
+
+    fclose(file);
+    return TRUE;
+}
+
+enum bool Replay_run(struct Chip8 *chip8, struct Replay_script *script,
+                     uint32_t *frame, uint32_t end_frame)
+{
+    for (; *frame < end_frame; (*frame)++) {
+        enum bool invalidate_display;
+
+        while (script->next_event < script->event_count
+               && script->events[script->next_event].frame <= *frame) {
+            const struct Replay_event *event =
+                &script->events[script->next_event];
+
+            Chip8_set_key(chip8, event->key_number, event->pressed);
+            script->next_event++;
+        }
+
+        if (!Chip8_run_frame(chip8, &invalidate_display)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+uint64_t Replay_hash_frame(const struct Chip8 *chip8)
+{
+    uint8_t bytes[HASH_CHUNK_WORD_COUNT * sizeof(uint64_t)];
+    uint16_t width, height;
+    const uint64_t *display = Chip8_framebuffer(chip8, &width, &height);
+    size_t word_count = (size_t) PLANE_COUNT * PLANE_WORD_COUNT;
+    uint64_t hash = (uint64_t) width << 16 | height;
+    size_t i, j;
+
+    /* Pixels outside of the current resolution are always off, so the
+     * whole framebuffer can be hashed. Words are hashed most significant
+     * byte first, as capture files store them, so that hashes agree
+     * whatever the host's byte order; each chunk seeds the next. */
+    for (i = 0; i < word_count; i += HASH_CHUNK_WORD_COUNT) {
+        size_t chunk_count = word_count - i < HASH_CHUNK_WORD_COUNT
+                             ? word_count - i : HASH_CHUNK_WORD_COUNT;
+
+        for (j = 0; j < chunk_count * sizeof(uint64_t); j++) {
+            bytes[j] = (uint8_t) (display[i + j / sizeof(uint64_t)]
+                                  >> (CHAR_BIT_COUNT
+                                      * (sizeof(uint64_t) - 1
+                                         - j % sizeof(uint64_t))));
+        }
+        hash = Hash_xxh64(bytes, chunk_count * sizeof(uint64_t), hash);
+    }
+    return hash;
+}
+
+enum bool Replay_write_pbm(const struct Chip8 *chip8, const char *file_name)
+{
+    uint16_t width, height;
+    const uint64_t *display = Chip8_framebuffer(chip8, &width, &height);
+
+    return Replay_write_display_pbm(display, width, height, file_name);
+}
+
+enum bool Replay_write_display_pbm(const uint64_t *display, uint16_t width,
+                                   uint16_t height, const char *file_name)
+{
+    uint16_t x, y;
+    enum bool written;
+    FILE *file;
+
+    file = fopen(file_name, "wb");
+    if (!file) {
+        fprintf(stderr, "The frame could not be written to '%s'.\n",
+                file_name);
+        return FALSE;
+    }
+
+    /* A PBM row is packed 8 pixels to a byte with the leftmost pixel in the
+     * most significant bit, the same order as the words of the display. */
+    written = fprintf(file, "P4\n%u %u\n", width, height) > 0;
+    for (y = 0; y < height && written; y++) {
+        const uint64_t *first = display + y * ROW_WORD_COUNT;
+        const uint64_t *second = first + PLANE_WORD_COUNT;
+
+        for (x = 0; x < width; x += CHAR_BIT_COUNT) {
+            unsigned int word = x / WORD_BIT_COUNT;
+            unsigned int shift = WORD_BIT_COUNT - CHAR_BIT_COUNT
+                                 - x % WORD_BIT_COUNT;
+
+            if (fputc((int) (((first[word] | second[word]) >> shift) & 0xFF),
+                      file) == EOF) {
+                written = FALSE;
+                break;
+            }
+        }
+    }
+
+    if (fclose(file) != 0 || !written) {
+        fprintf(stderr, "The frame could not be written to '%s'.\n",
+                file_name);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+enum bool Replay_write_display_gif(const uint64_t *display, uint16_t width,
+                                   uint16_t height, const char *file_name)
+{
+    /* The shade of each combination of bitplanes, the first plane being
+     * black on white as in the PBM. */
+    static const uint8_t PALETTE[] = {
+        0xFF, 0xFF, 0xFF,  0x00, 0x00, 0x00,
+        0xAA, 0xAA, 0xAA,  0x55, 0x55, 0x55
+    };
+    /* The signature, the logical screen descriptor (its size, a 4 colour
+     * global palette, which follows), and the image descriptor (its place
+     * and size, and the LZW minimum code size). */
+    uint8_t header[] = {
+        'G', 'I', 'F', '8', '9', 'a', 0, 0, 0, 0, 0x91, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        ',', 0, 0, 0, 0, 0, 0, 0, 0, 0, GIF_CODE_BITS - 1
+    };
+    uint8_t block[GIF_BLOCK_SIZE + 1];
+    unsigned int since_clear = GIF_CODES_PER_CLEAR;
+    enum bool written;
+    uint16_t x, y;
+    FILE *file;
+
+    file = fopen(file_name, "wb");
+    if (!file) {
+        fprintf(stderr, "The frame could not be written to '%s'.\n",
+                file_name);
+        return FALSE;
+    }
+
+    header[6] = header[30] = (uint8_t) (width & 0xFF);
+    header[7] = header[31] = (uint8_t) (width >> 8);
+    header[8] = header[32] = (uint8_t) (height & 0xFF);
+    header[9] = header[33] = (uint8_t) (height >> 8);
+    memcpy(header + 13, PALETTE, sizeof PALETTE);
+    written = fwrite(header, 1, sizeof header, file) == sizeof header;
+
+    /* The pixels are coded with LZW, but with the table cleared before it
+     * grows past 8-bit codes, so that every code is a pixel and a byte.
+     * That gives up compression for simplicity; frames are small. */
+    block[0] = 0;
+    for (y = 0; y < height && written; y++) {
+        const uint64_t *first = display + y * ROW_WORD_COUNT;
+        const uint64_t *second = first + PLANE_WORD_COUNT;
+
+        for (x = 0; x < width && written; x++) {
+            unsigned int word = x / WORD_BIT_COUNT;
+            unsigned int bit = WORD_BIT_COUNT - 1 - x % WORD_BIT_COUNT;
+
+            if (since_clear == GIF_CODES_PER_CLEAR) {
+                written = put_gif_code(file, block, GIF_CLEAR_CODE);
+                since_clear = 0;
+            }
+            written = written
+                      && put_gif_code(file, block, (uint8_t)
+                                      (((first[word] >> bit) & 1u)
+                                       | ((second[word] >> bit) & 1u) << 1));
+            since_clear++;
+        }
+    }
+
+    written = written && put_gif_code(file, block, GIF_CLEAR_CODE + 1)
+              && (block[0] == 0
+                  || fwrite(block, 1, block[0] + 1u, file) == block[0] + 1u)
+              && fputc(0, file) != EOF && fputc(';', file) != EOF;
+
+    if (fclose(file) != 0 || !written) {
+        fprintf(stderr, "The frame could not be written to '%s'.\n",
+                file_name);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+void Replay_free_script(struct Replay_script *script)
+{
+    free(script->events);
+    memset(script, 0, sizeof *script);
+}
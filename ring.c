@@ -0,0 +1,110 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "constant.h"
+#include "ring.h"
+
+/* -------------------------------------------------------------------------- */
+/* Private Interface -------------------------------------------------------- */
+
+/* Copy the `size` bytes at `data` into the ring as byte `count` onwards of
+ * the stream, wrapping around the end of the buffer. */
+static void copy_in(struct Ring *ring, size_t count, const uint8_t *data,
+                    size_t size)
+{
+    size_t start = count & ring->mask;
+    size_t first = ring->mask + 1 - start;
+
+    if (first > size) {
+        first = size;
+    }
+    memcpy(ring->buffer + start, data, first);
+    memcpy(ring->buffer, data + first, size - first);
+}
+
+/* Copy `size` bytes from byte `count` onwards of the stream into `data`. */
+static void copy_out(const struct Ring *ring, size_t count, uint8_t *data,
+                     size_t size)
+{
+    size_t start = count & ring->mask;
+    size_t first = ring->mask + 1 - start;
+
+    if (first > size) {
+        first = size;
+    }
+    memcpy(data, ring->buffer + start, first);
+    memcpy(data + first, ring->buffer, size - first);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Public Interface --------------------------------------------------------- */
+
+enum bool Ring_init(struct Ring *ring, size_t capacity)
+{
+    size_t size = 1;
+
+    while (size < capacity) {
+        size *= 2;
+    }
+
+    ring->buffer = malloc(size);
+    if (!ring->buffer) {
+        return FALSE;
+    }
+    ring->mask = size - 1;
+    atomic_init(&ring->write_count, 0);
+    atomic_init(&ring->read_count, 0);
+
+    return TRUE;
+}
+
+enum bool Ring_write(struct Ring *ring, const void *data, size_t size)
+{
+    size_t written = atomic_load_explicit(&ring->write_count,
+                                          memory_order_relaxed);
+
+    if (size > Ring_free_size(ring)) {
+        return FALSE;
+    }
+
+    /* The bytes must be in place before the consumer can see the count. */
+    copy_in(ring, written, data, size);
+    atomic_store_explicit(&ring->write_count, written + size,
+                          memory_order_release);
+    return TRUE;
+}
+
+size_t Ring_free_size(struct Ring *ring)
+{
+    size_t written = atomic_load_explicit(&ring->write_count,
+                                          memory_order_relaxed);
+    /* The consumer must be done with the bytes before they are reused. */
+    size_t read = atomic_load_explicit(&ring->read_count,
+                                       memory_order_acquire);
+
+    return ring->mask + 1 - (written - read);
+}
+
+size_t Ring_read(struct Ring *ring, void *data, size_t size)
+{
+    size_t read = atomic_load_explicit(&ring->read_count,
+                                       memory_order_relaxed);
+    size_t written = atomic_load_explicit(&ring->write_count,
+                                          memory_order_acquire);
+
+    if (size > written - read) {
+        size = written - read;
+    }
+
+    copy_out(ring, read, data, size);
+    atomic_store_explicit(&ring->read_count, read + size,
+                          memory_order_release);
+    return size;
+}
+
+void Ring_uninit(struct Ring *ring)
+{
+    free(ring->buffer);
+}
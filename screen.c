@@ -6,59 +6,252 @@
 #include <limits.h>
 
 #include "constant.h"
-#include "port.h"
 #include "screen.h"
 
-/* A bit vector representing the system's monochrome screen.
- * Each bit represents the on/off state of a single pixel. */
-static uint8_t *display;
+/* -------------------------------------------------------------------------- */
+/* Private Interface -------------------------------------------------------- */
 
-enum bool Screen_init(void)
+/* Return a pointer to the first word of row `y` of bitplane `plane`. */
+static uint64_t *row_of(struct Screen *screen, uint8_t plane, uint16_t y)
 {
-    /* The screen size should always be a whole number of bytes. */
-    assert(PIXEL_COUNT % CHAR_BIT == 0);
+    return screen->display + plane * PLANE_WORD_COUNT + y * ROW_WORD_COUNT;
+}
+
+static enum bool is_selected(const struct Screen *screen, uint8_t plane)
+{
+    return (screen->selected_planes >> plane) & 1u ? TRUE : FALSE;
+}
+
+/* XOR `bits` (left aligned in the word) onto the row at pixel column `x`,
+ * spilling into the next word when the sprite crosses a word boundary.
+ * Return TRUE if any pixel was turned off. */
+static enum bool xor_row(const struct Screen *screen, uint64_t *row,
+                         uint16_t x, uint64_t bits)
+{
+    uint16_t word_index = x / WORD_BIT_COUNT;
+    uint16_t shift = x % WORD_BIT_COUNT;
+    uint16_t next_index = (word_index + 1) % screen->row_word_count;
+    uint64_t head = bits >> shift;
+    uint64_t tail = shift ? bits << (WORD_BIT_COUNT - shift) : 0;
+    enum bool collision;
+
+    /* The tail of the sprite leaves the right edge of the screen. */
+    if (next_index == 0 && screen->clip_sprites) {
+        tail = 0;
+    }
+
+    collision = (row[word_index] & head) || (row[next_index] & tail)
+                ? TRUE : FALSE;
+    row[word_index] ^= head;
+    row[next_index] ^= tail;
+
+    return collision;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Public Interface --------------------------------------------------------- */
+
+enum bool Screen_init(struct Screen *screen, enum Chip8_mode mode)
+{
+    /* Rows are always a whole number of words. */
+    assert(HIRES_WIDTH_PIXEL_COUNT % WORD_BIT_COUNT == 0);
+    assert(WIDTH_PIXEL_COUNT % WORD_BIT_COUNT == 0);
 
-    display = calloc(PIXEL_COUNT / CHAR_BIT, sizeof *display);
-    return display == NULL ? FALSE : TRUE;
+    screen->display = calloc(PLANE_COUNT * PLANE_WORD_COUNT,
+                             sizeof(uint64_t));
+    if (!screen->display) {
+        return FALSE;
+    }
+
+    screen->selected_planes = 1;
+    screen->clip_sprites = mode == MODE_SCHIP ? TRUE : FALSE;
+    Screen_set_hires(screen, FALSE);
+
+    return TRUE;
 }
 
-enum bool Screen_paint(uint8_t x, uint8_t y, uint8_t value)
+uint8_t Screen_draw_sprite(struct Screen *screen, uint8_t x, uint8_t y,
+                           const uint8_t *sprite, uint8_t width, uint8_t height)
 {
-    uint16_t pixel_index;
-    uint8_t pixel_byte, pixel_bit;
-    uint8_t old_value;
+    uint8_t plane, i;
+    uint8_t collided_rows = 0;
+    uint8_t bytes_per_row = width / CHAR_BIT_COUNT;
+
+    assert(width == 8 || width == 16);
+
+    /* The starting coordinates are allowed to be outside of the bounds of
+     * the screen (they are wrapped around). */
+    x %= screen->width;
+    y %= screen->height;
 
-    assert(value == 0 || value == 1);
+    for (plane = 0; plane < PLANE_COUNT; plane++) {
+        if (!is_selected(screen, plane)) {
+            continue;
+        }
 
-    /* The x and y coordinates are allowed to be outside of the bounds of the
-     * screen (they are wrapped around). */
-    x %= WIDTH_PIXEL_COUNT;
-    y %= HEIGHT_PIXEL_COUNT;
+        for (i = 0; i < height; i++, sprite += bytes_per_row) {
+            uint16_t sprite_row = width == 8
+                                  ? sprite[0]
+                                  : (uint16_t) (sprite[0] << 8u | sprite[1]);
+            uint16_t row_y = y + i;
 
-    pixel_index = y * WIDTH_PIXEL_COUNT + x;
-    pixel_byte = pixel_index / CHAR_BIT;
-    pixel_bit = pixel_index % CHAR_BIT;
+            if (row_y >= screen->height) {
+                if (screen->clip_sprites) {
+                    continue;
+                }
+                row_y %= screen->height;
+            }
 
-    /* On the CHIP-8, pixels are XORed onto the screen when they are painted. */
-    old_value = (display[pixel_byte] >> pixel_bit) & 1u;
-    display[pixel_byte] ^= value << pixel_bit;
+            /* On the CHIP-8, pixels are XORed onto the screen when they are
+             * painted. Our return value indicates collision. */
+            if (xor_row(screen, row_of(screen, plane, row_y), x,
+                        (uint64_t) sprite_row << (WORD_BIT_COUNT - width))) {
+                collided_rows++;
+            }
+        }
+    }
 
-    /* Our return value indicates collision.
-     * If we just turned off a pixel, return true. */
-    return old_value && value ? TRUE : FALSE;
+    return collided_rows;
 }
 
 //todo: change name to make clear diff btwn this and Port_clear_display
-void Screen_clear(void)
+void Screen_clear(struct Screen *screen)
 {
-    memset(display, 0, PIXEL_COUNT / CHAR_BIT);
+    uint8_t plane;
+
+    for (plane = 0; plane < PLANE_COUNT; plane++) {
+        if (is_selected(screen, plane)) {
+            memset(row_of(screen, plane, 0), 0,
+                   PLANE_WORD_COUNT * sizeof(uint64_t));
+        }
+    }
 }
 
-void Screen_display(void) {
-    Port_display_screen(display);
+void Screen_set_hires(struct Screen *screen, enum bool hires)
+{
+    screen->width = hires ? HIRES_WIDTH_PIXEL_COUNT : WIDTH_PIXEL_COUNT;
+    screen->height = hires ? HIRES_HEIGHT_PIXEL_COUNT : HEIGHT_PIXEL_COUNT;
+    screen->row_word_count = screen->width / WORD_BIT_COUNT;
+
+    memset(screen->display, 0,
+           PLANE_COUNT * PLANE_WORD_COUNT * sizeof(uint64_t));
+}
+
+enum bool Screen_is_hires(const struct Screen *screen)
+{
+    return screen->width == HIRES_WIDTH_PIXEL_COUNT ? TRUE : FALSE;
+}
+
+void Screen_select_planes(struct Screen *screen, uint8_t plane_mask)
+{
+    screen->selected_planes = plane_mask;
+}
+
+void Screen_scroll_down(struct Screen *screen, uint8_t count)
+{
+    uint8_t plane;
+
+    if (count > screen->height) {
+        count = screen->height;
+    }
+
+    for (plane = 0; plane < PLANE_COUNT; plane++) {
+        if (!is_selected(screen, plane)) {
+            continue;
+        }
+        memmove(row_of(screen, plane, count), row_of(screen, plane, 0),
+                (screen->height - count) * ROW_WORD_COUNT * sizeof(uint64_t));
+        memset(row_of(screen, plane, 0), 0,
+               count * ROW_WORD_COUNT * sizeof(uint64_t));
+    }
+}
+
+void Screen_scroll_up(struct Screen *screen, uint8_t count)
+{
+    uint8_t plane;
+
+    if (count > screen->height) {
+        count = screen->height;
+    }
+
+    for (plane = 0; plane < PLANE_COUNT; plane++) {
+        if (!is_selected(screen, plane)) {
+            continue;
+        }
+        memmove(row_of(screen, plane, 0), row_of(screen, plane, count),
+                (screen->height - count) * ROW_WORD_COUNT * sizeof(uint64_t));
+        memset(row_of(screen, plane, screen->height - count), 0,
+               count * ROW_WORD_COUNT * sizeof(uint64_t));
+    }
+}
+
+void Screen_scroll_left(struct Screen *screen, uint8_t count)
+{
+    uint8_t plane;
+    uint16_t y, i;
+
+    assert(count < WORD_BIT_COUNT);
+    if (count == 0) {
+        return;
+    }
+
+    for (plane = 0; plane < PLANE_COUNT; plane++) {
+        if (!is_selected(screen, plane)) {
+            continue;
+        }
+        for (y = 0; y < screen->height; y++) {
+            uint64_t *row = row_of(screen, plane, y);
+
+            /* Shift the row as one wide integer, carrying the leftmost
+             * pixels of each word into the word before it. */
+            for (i = 0; i < screen->row_word_count; i++) {
+                row[i] <<= count;
+                if (i + 1 < screen->row_word_count) {
+                    row[i] |= row[i + 1] >> (WORD_BIT_COUNT - count);
+                }
+            }
+        }
+    }
+}
+
+void Screen_scroll_right(struct Screen *screen, uint8_t count)
+{
+    uint8_t plane;
+    uint16_t y, i;
+
+    assert(count < WORD_BIT_COUNT);
+    if (count == 0) {
+        return;
+    }
+
+    for (plane = 0; plane < PLANE_COUNT; plane++) {
+        if (!is_selected(screen, plane)) {
+            continue;
+        }
+        for (y = 0; y < screen->height; y++) {
+            uint64_t *row = row_of(screen, plane, y);
+
+            /* As above, carrying the rightmost pixels of each
+             * word into the word after it. */
+            for (i = screen->row_word_count; i-- > 0;) {
+                row[i] >>= count;
+                if (i > 0) {
+                    row[i] |= row[i - 1] << (WORD_BIT_COUNT - count);
+                }
+            }
+        }
+    }
+}
+
+const uint64_t *Screen_framebuffer(const struct Screen *screen,
+                                   uint16_t *width, uint16_t *height)
+{
+    *width = screen->width;
+    *height = screen->height;
+    return screen->display;
 }
 
-void Screen_uninit(void)
+void Screen_uninit(struct Screen *screen)
 {
-    free(display);
+    free(screen->display);
 }
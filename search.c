@@ -0,0 +1,444 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "replay.h"
+#include "set.h"
+
+/* The choice of holding no key down for a step. */
+#define NO_KEY 16
+
+/* Marks that no state has reached the goal yet. */
+#define NOT_FOUND UINT32_MAX
+
+/* A state waiting to be expanded. */
+struct node {
+    uint32_t id;
+    uint8_t *state;
+};
+
+/* Everything shared between the threads expanding a level of the search. */
+struct search {
+    /* The application, loaded once in `origin` and run by one machine per
+     * thread sharing its memory image. */
+    enum Chip8_mode mode;
+    struct Chip8 *origin;
+    uint64_t seed;
+
+    /* The keypad choices branched on at each step, and the number of frames
+     * each choice is held for. */
+    uint8_t choices[NO_KEY + 1];
+    unsigned int choice_count;
+    uint32_t frames_per_step;
+
+    /* The hash of the frame to search for, if `has_goal`. */
+    enum bool has_goal;
+    uint64_t goal;
+
+    /* The hashes of every state seen so far. */
+    struct Set visited;
+
+    /* For each state, by id, the state it was reached from and the choice
+     * that reached it, for recovering input sequences. */
+    uint32_t *parents;
+    uint8_t *keys;
+    uint32_t max_state_count;
+    atomic_uint_fast32_t state_count;
+
+    /* The level being expanded, taken a node at a time, and the level
+     * being built from it. */
+    struct node *level;
+    size_t level_size;
+    atomic_size_t next_node;
+    struct node *next_level;
+    atomic_size_t next_level_size;
+
+    /* Set when a state had to be dropped for want of room. */
+    atomic_bool truncated;
+
+    /* The first state found showing the goal frame, or NOT_FOUND. */
+    atomic_uint_fast32_t found;
+};
+
+/* A thread's machine and scratch space. */
+struct worker {
+    struct search *search;
+    struct Chip8 *chip8;
+    uint8_t *scratch;
+    enum bool failed;
+};
+
+/* Record the state the machine of `worker` is in, reached from state
+ * `parent` by `key`, and queue it for the next level if it is new. Return
+ * FALSE on error. */
+static enum bool visit(struct worker *worker, uint32_t parent, uint8_t key) {
+    struct search *search = worker->search;
+    struct node *node;
+    uint32_t id;
+    size_t size;
+
+    switch (Set_add(&search->visited, Chip8_state_hash(worker->chip8))) {
+        case SET_PRESENT:
+            return TRUE;
+        case SET_FULL:
+            atomic_store(&search->truncated, TRUE);
+            return TRUE;
+        case SET_ADDED:
+            break;
+    }
+
+    id = (uint32_t) atomic_fetch_add(&search->state_count, 1);
+    if (id >= search->max_state_count) {
+        atomic_store(&search->truncated, TRUE);
+        return TRUE;
+    }
+    search->parents[id] = parent;
+    search->keys[id] = key;
+
+    if (search->has_goal && Replay_hash_frame(worker->chip8) == search->goal) {
+        uint_fast32_t none = NOT_FOUND;
+
+        atomic_compare_exchange_strong(&search->found, &none, id);
+    }
+
+    /* There is no point expanding a state the application exited in. */
+    if (Chip8_is_halted(worker->chip8)) {
+        return TRUE;
+    }
+
+    size = Chip8_save_state(worker->chip8, worker->scratch);
+    node = &search->next_level[atomic_fetch_add(&search->next_level_size, 1)];
+    node->id = id;
+    node->state = malloc(size);
+    if (!node->state) {
+        return FALSE;
+    }
+    memcpy(node->state, worker->scratch, size);
+
+    return TRUE;
+}
+
+/* Run the machine of `worker` for one step from `state`, holding `key`
+ * down. Return FALSE if the application executed something invalid. */
+static enum bool step(struct worker *worker, const uint8_t *state,
+                      uint8_t key) {
+    struct search *search = worker->search;
+    enum bool invalidate_display;
+    uint32_t frame;
+    uint8_t i;
+
+    Chip8_restore_state(worker->chip8, state);
+    if (key != NO_KEY) {
+        Chip8_set_key(worker->chip8, key, TRUE);
+    }
+
+    for (frame = 0; frame < search->frames_per_step; frame++) {
+        if (!Chip8_run_frame(worker->chip8, &invalidate_display)) {
+            /* The machine unloads itself on invalid execution. */
+            Chip8_load_shared_rom(worker->chip8, search->origin);
+            return FALSE;
+        }
+    }
+
+    /* Keys are released between steps, so that equal states compare
+     * equal whatever was pressed to reach them. */
+    for (i = 0; i < NO_KEY; i++) {
+        Chip8_set_key(worker->chip8, i, FALSE);
+    }
+    return TRUE;
+}
+
+/* Worker thread: expand nodes of the current level until none are left. */
+static void *expand(void *argument) {
+    struct worker *worker = argument;
+    struct search *search = worker->search;
+
+    for (;;) {
+        size_t index = atomic_fetch_add(&search->next_node, 1);
+        const struct node *node;
+        unsigned int i;
+
+        if (index >= search->level_size
+            || atomic_load(&search->found) != NOT_FOUND) {
+            return NULL;
+        }
+        node = &search->level[index];
+
+        for (i = 0; i < search->choice_count; i++) {
+            uint8_t key = search->choices[i];
+
+            if (step(worker, node->state, key)
+                && !visit(worker, node->id, key)) {
+                worker->failed = TRUE;
+                return NULL;
+            }
+        }
+    }
+}
+
+/* Print the steps leading to state `id` as an input script for
+ * chip8_headless. */
+static void print_script(const struct search *search, uint32_t id) {
+    uint32_t depth = 0;
+    uint32_t at;
+    uint8_t *path;
+    uint8_t held = NO_KEY;
+    uint32_t i;
+
+    for (at = id; at != 0; at = search->parents[at]) {
+        depth++;
+    }
+    path = malloc(depth ? depth : 1);
+    if (!path) {
+        return;
+    }
+    for (at = id, i = depth; at != 0; at = search->parents[at]) {
+        path[--i] = search->keys[at];
+    }
+
+    printf("# %lu steps of %lu frames; run %lu frames to reach the goal.\n",
+           (unsigned long) depth, (unsigned long) search->frames_per_step,
+           (unsigned long) (depth * search->frames_per_step));
+    for (i = 0; i < depth; i++) {
+        unsigned long frame = (unsigned long) i * search->frames_per_step;
+
+        if (held != NO_KEY) {
+            printf("%lu %X up\n", frame, held);
+        }
+        if (path[i] != NO_KEY) {
+            printf("%lu %X down\n", frame, path[i]);
+        }
+        held = path[i];
+    }
+    if (held != NO_KEY) {
+        printf("%lu %X up\n",
+               (unsigned long) depth * search->frames_per_step, held);
+    }
+
+    free(path);
+}
+
+/* Parse the keys to branch on from `text`, hexadecimal digits with `-`
+ * meaning no key, into `search`. Return TRUE on success. */
+static enum bool parse_choices(struct search *search, const char *text) {
+    search->choice_count = 0;
+    for (; *text; text++) {
+        unsigned int key;
+
+        if (*text == '-') {
+            key = NO_KEY;
+        }
+        else if (sscanf((char[]) {*text, '\0'}, "%x", &key) != 1) {
+            return FALSE;
+        }
+        if (search->choice_count == NO_KEY + 1) {
+            return FALSE;
+        }
+        search->choices[search->choice_count++] = (uint8_t) key;
+    }
+    return search->choice_count > 0 ? TRUE : FALSE;
+}
+
+/* Search the states the ROM can reach breadth first, branching at each
+ * step on which key (if any) is held down, and print the number of new
+ * states at each depth. With `-g`, stop at the first state showing the
+ * frame with that hash (as printed by chip8_headless) and print an input
+ * script reaching it. */
+int main(int argc, char *argv[]) {
+    struct search search;
+    struct worker *workers;
+    pthread_t *threads;
+    long thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t max_depth = UINT32_MAX;
+    uint32_t depth;
+    uint_fast32_t previous_count = 0;
+    enum bool usage = FALSE;
+    enum bool failed = FALSE;
+    size_t j;
+    long i;
+    int option;
+
+    memset(&search, 0, sizeof search);
+    search.mode = MODE_CHIP8;
+    search.seed = 1;
+    search.frames_per_step = 1;
+    search.max_state_count = 1000000;
+    parse_choices(&search, "-0123456789ABCDEF");
+
+    while ((option = getopt(argc, argv, "sxk:f:d:m:j:g:r:")) != -1) {
+        switch (option) {
+            case 's':
+                search.mode = MODE_SCHIP;
+                break;
+            case 'x':
+                search.mode = MODE_XOCHIP;
+                break;
+            case 'k':
+                usage = !parse_choices(&search, optarg);
+                break;
+            case 'f':
+                search.frames_per_step = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'd':
+                max_depth = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'm':
+                search.max_state_count = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'j':
+                thread_count = strtol(optarg, NULL, 10);
+                break;
+            case 'g':
+                search.has_goal = TRUE;
+                search.goal = strtoull(optarg, NULL, 16);
+                break;
+            case 'r':
+                search.seed = strtoull(optarg, NULL, 0);
+                break;
+            default:
+                usage = TRUE;
+                break;
+        }
+    }
+
+    if (usage || optind != argc - 1 || search.frames_per_step == 0
+        || search.max_state_count == 0) {
+        fprintf(stderr, "Usage: %s [-s | -x] [-k <keys>] [-f <frames>] "
+                        "[-d <depth>] [-m <states>] [-j <threads>] "
+                        "[-g <frame_hash>] [-r <seed>] <rom_file>\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+
+    search.origin = Chip8_create(search.mode);
+    if (!search.origin || !Chip8_load_rom_file(search.origin, argv[optind])) {
+        return EXIT_FAILURE;
+    }
+
+    /* Every state is reached by exactly one parent, so these never hold
+     * more than `max_state_count` entries. */
+    search.parents = malloc(search.max_state_count * sizeof *search.parents);
+    search.keys = malloc(search.max_state_count);
+    search.level = malloc(search.max_state_count * sizeof *search.level);
+    search.next_level = malloc(search.max_state_count
+                               * sizeof *search.next_level);
+    workers = calloc((size_t) thread_count, sizeof *workers);
+    threads = malloc((size_t) thread_count * sizeof *threads);
+    if (!search.parents || !search.keys || !search.level
+        || !search.next_level || !workers || !threads
+        || !Set_init(&search.visited, search.max_state_count)) {
+        fprintf(stderr, "Not enough memory for %lu states.\n",
+                (unsigned long) search.max_state_count);
+        return EXIT_FAILURE;
+    }
+    atomic_init(&search.found, NOT_FOUND);
+
+    for (i = 0; i < thread_count && !failed; i++) {
+        workers[i].search = &search;
+        workers[i].chip8 = Chip8_create(search.mode);
+        failed = !workers[i].chip8
+                 || !Chip8_load_shared_rom(workers[i].chip8, search.origin);
+        if (!failed) {
+            Chip8_seed(workers[i].chip8, search.seed);
+            workers[i].scratch = malloc(Chip8_state_size(workers[i].chip8));
+            failed = !workers[i].scratch;
+        }
+    }
+
+    /* The power on state is the root of the search. */
+    if (!failed) {
+        failed = !visit(&workers[0], 0, NO_KEY);
+    }
+
+    for (depth = 0; !failed; depth++) {
+        uint_fast32_t state_count = atomic_load(&search.state_count);
+        struct node *swap;
+
+        /* Halted states count as new, but are not expanded further. */
+        if (state_count > search.max_state_count) {
+            state_count = search.max_state_count;
+        }
+        fprintf(stderr, "depth %lu: %lu new states, %lu visited\n",
+                (unsigned long) depth,
+                (unsigned long) (state_count - previous_count),
+                (unsigned long) Set_count(&search.visited));
+        previous_count = state_count;
+
+        if (atomic_load(&search.found) != NOT_FOUND || depth == max_depth
+            || atomic_load(&search.next_level_size) == 0) {
+            break;
+        }
+
+        /* The new states become the level to expand. */
+        for (j = 0; j < search.level_size; j++) {
+            free(search.level[j].state);
+        }
+        swap = search.level;
+        search.level = search.next_level;
+        search.next_level = swap;
+        search.level_size = atomic_load(&search.next_level_size);
+        atomic_store(&search.next_level_size, 0);
+        atomic_store(&search.next_node, 0);
+
+        for (i = 0; i < thread_count; i++) {
+            if (pthread_create(&threads[i], NULL, expand,
+                               &workers[i]) != 0) {
+                /* Fewer threads just take longer. */
+                break;
+            }
+        }
+        if (i == 0) {
+            expand(&workers[0]);
+        }
+        while (i > 0) {
+            pthread_join(threads[--i], NULL);
+        }
+        for (i = 0; i < thread_count; i++) {
+            failed = failed || workers[i].failed;
+        }
+    }
+
+    if (atomic_load(&search.truncated)) {
+        fprintf(stderr, "The search ran out of room; raise -m to search "
+                        "further.\n");
+    }
+    if (atomic_load(&search.found) != NOT_FOUND) {
+        print_script(&search, (uint32_t) atomic_load(&search.found));
+    }
+    else if (search.has_goal && !failed) {
+        fprintf(stderr, "The goal frame was not reached.\n");
+    }
+
+    for (i = 0; i < thread_count; i++) {
+        if (workers[i].chip8) {
+            Chip8_destroy(workers[i].chip8);
+        }
+        free(workers[i].scratch);
+    }
+    for (j = 0; j < search.level_size; j++) {
+        free(search.level[j].state);
+    }
+    for (j = 0; j < atomic_load(&search.next_level_size); j++) {
+        free(search.next_level[j].state);
+    }
+    Set_uninit(&search.visited);
+    free(threads);
+    free(workers);
+    free(search.next_level);
+    free(search.level);
+    free(search.keys);
+    free(search.parents);
+    Chip8_destroy(search.origin);
+
+    return failed || (search.has_goal
+                      && atomic_load(&search.found) == NOT_FOUND)
+           ? EXIT_FAILURE : EXIT_SUCCESS;
+}
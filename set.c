@@ -0,0 +1,83 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "constant.h"
+#include "set.h"
+
+/* -------------------------------------------------------------------------- */
+/* Private Interface -------------------------------------------------------- */
+
+/* Marks a slot which holds no hash. */
+static const uint64_t EMPTY = 0;
+
+/* -------------------------------------------------------------------------- */
+/* Public Interface --------------------------------------------------------- */
+
+enum bool Set_init(struct Set *set, size_t capacity)
+{
+    size_t slot_count = 1;
+    size_t i;
+
+    /* Keeping the table at most half full keeps the probes short. */
+    while (slot_count < 2 * capacity) {
+        slot_count *= 2;
+    }
+
+    set->slots = malloc(slot_count * sizeof *set->slots);
+    if (!set->slots) {
+        return FALSE;
+    }
+    for (i = 0; i < slot_count; i++) {
+        atomic_init(&set->slots[i], EMPTY);
+    }
+    set->mask = slot_count - 1;
+    atomic_init(&set->count, 0);
+
+    return TRUE;
+}
+
+enum Set_result Set_add(struct Set *set, uint64_t hash)
+{
+    size_t index, probe;
+
+    if (hash == EMPTY) {
+        hash = 1;
+    }
+
+    /* The hashes are already well mixed, so their low bits pick the slot. */
+    index = (size_t) hash & set->mask;
+    for (probe = 0; probe <= set->mask; probe++) {
+        uint64_t found = atomic_load_explicit(&set->slots[index],
+                                              memory_order_relaxed);
+
+        if (found == EMPTY) {
+            /* Claim the slot, unless another thread beat us to it, in
+             * which case it may have been for the same hash. */
+            if (atomic_compare_exchange_strong_explicit(
+                    &set->slots[index], &found, hash,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                atomic_fetch_add_explicit(&set->count, 1,
+                                          memory_order_relaxed);
+                return SET_ADDED;
+            }
+        }
+        if (found == hash) {
+            return SET_PRESENT;
+        }
+
+        index = (index + 1) & set->mask;
+    }
+
+    return SET_FULL;
+}
+
+size_t Set_count(const struct Set *set)
+{
+    return atomic_load_explicit(&set->count, memory_order_relaxed);
+}
+
+void Set_uninit(struct Set *set)
+{
+    free(set->slots);
+}
@@ -0,0 +1,97 @@
+#include <stdint.h>
+#include <math.h>
+
+#include "constant.h"
+#include "cpu.h"
+#include "ring.h"
+#include "sound.h"
+
+/* -------------------------------------------------------------------------- */
+/* Private Interface -------------------------------------------------------- */
+
+/* The number of bits in the audio pattern. */
+#define PATTERN_BIT_COUNT 128
+
+/* The number of samples generated at once, bounding the stack used. */
+#define CHUNK_SAMPLE_COUNT 256
+
+/* The level of a set pattern bit; a clear bit is its negation. Loud enough
+ * to hear, and well short of clipping. */
+static const int16_t AMPLITUDE = 8192;
+
+/* Return how far the pattern moves each sample at `pitch`. XO-CHIP plays
+ * the pattern at 4000 * 2^((pitch - 64) / 48) bits per second. */
+static uint64_t phase_step_of(uint8_t pitch)
+{
+    double bits_per_second = 4000.0 * pow(2.0, (pitch - 64) / 48.0);
+
+    return (uint64_t) (bits_per_second / SAMPLE_RATE * 4294967296.0);
+}
+
+/* Bring the generator up to date with `cpu`. */
+static void update(struct Sound *sound, const struct Cpu *cpu)
+{
+    sound->playing = cpu->sound_timer > 0 ? TRUE : FALSE;
+    if (cpu->pitch != sound->pitch) {
+        sound->pitch = cpu->pitch;
+        sound->phase_step = phase_step_of(sound->pitch);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Public Interface --------------------------------------------------------- */
+
+void Sound_init(struct Sound *sound, struct Ring *ring, const struct Cpu *cpu)
+{
+    sound->ring = ring;
+    sound->frame_samples = 0;
+    sound->phase = 0;
+    sound->dropped_samples = 0;
+    sound->pitch = cpu->pitch;
+    sound->phase_step = phase_step_of(sound->pitch);
+    update(sound, cpu);
+}
+
+void Sound_render(struct Sound *sound, const struct Cpu *cpu,
+                  uint32_t frame_sample)
+{
+    const uint64_t phase_mask = ((uint64_t) PATTERN_BIT_COUNT << 32) - 1;
+    int16_t samples[CHUNK_SAMPLE_COUNT];
+
+    while (sound->frame_samples < frame_sample) {
+        uint32_t count = frame_sample - sound->frame_samples;
+        uint32_t i;
+
+        if (count > CHUNK_SAMPLE_COUNT) {
+            count = CHUNK_SAMPLE_COUNT;
+        }
+
+        for (i = 0; i < count; i++) {
+            if (sound->playing) {
+                uint32_t bit = (uint32_t) (sound->phase >> 32);
+                uint8_t byte = cpu->audio_pattern[bit / CHAR_BIT_COUNT];
+
+                samples[i] = (byte >> (7 - bit % CHAR_BIT_COUNT)) & 1
+                             ? AMPLITUDE : (int16_t) -AMPLITUDE;
+                sound->phase = (sound->phase + sound->phase_step)
+                               & phase_mask;
+            }
+            else {
+                samples[i] = 0;
+            }
+        }
+
+        if (!Ring_write(sound->ring, samples, count * sizeof *samples)) {
+            sound->dropped_samples += count;
+        }
+        sound->frame_samples += count;
+    }
+
+    update(sound, cpu);
+}
+
+void Sound_end_frame(struct Sound *sound, const struct Cpu *cpu)
+{
+    Sound_render(sound, cpu, SAMPLES_PER_FRAME);
+    sound->frame_samples = 0;
+}
@@ -0,0 +1,177 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "constant.h"
+#include "stats.h"
+
+/* -------------------------------------------------------------------------- */
+/* Private Interface -------------------------------------------------------- */
+
+/* The number of buckets each power of 2 range above the exact ones is split
+ * into. */
+#define HALF_SUB_BUCKET_COUNT (1 << (HISTOGRAM_SUB_BUCKET_BITS - 1))
+
+/* The names of the histograms in reports, and what their values are divided
+ * by to print them. */
+static const char *const HISTOGRAM_NAMES[] = {
+    "frame_cycles", "display_us", "delay_overshoot_us", "key_latency_us"
+};
+static const double HISTOGRAM_SCALES[] = {1, 1000, 1000, 1000};
+
+/* The percentiles given in reports. */
+static const double PERCENTILES[] = {50, 90, 99, 99.9};
+
+/* Return the index of the most significant set bit of `value`, which must
+ * not be 0. */
+static unsigned int top_bit(uint64_t value) {
+    return 63 - (unsigned int) __builtin_clzll(value);
+}
+
+/* Return the bucket `value` is counted in. Above the exact values, each
+ * bucket keeps the top HISTOGRAM_SUB_BUCKET_BITS bits of a value. */
+static size_t bucket_of(uint64_t value) {
+    unsigned int shift;
+
+    if (value < 2 * HALF_SUB_BUCKET_COUNT) {
+        return (size_t) value;
+    }
+    shift = top_bit(value) - (HISTOGRAM_SUB_BUCKET_BITS - 1);
+    return (size_t) shift * HALF_SUB_BUCKET_COUNT + (size_t) (value >> shift);
+}
+
+/* Return the highest value counted in `bucket`. */
+static uint64_t bucket_limit(size_t bucket) {
+    unsigned int shift;
+
+    if (bucket < 2 * HALF_SUB_BUCKET_COUNT) {
+        return bucket;
+    }
+    shift = (unsigned int) (bucket / HALF_SUB_BUCKET_COUNT) - 1;
+    return ((uint64_t) (bucket % HALF_SUB_BUCKET_COUNT + HALF_SUB_BUCKET_COUNT)
+            << shift) + (((uint64_t) 1 << shift) - 1);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Public Interface --------------------------------------------------------- */
+
+void Histogram_init(struct Histogram *histogram) {
+    memset(histogram, 0, sizeof *histogram);
+    histogram->min = UINT64_MAX;
+}
+
+void Histogram_record(struct Histogram *histogram, uint64_t value) {
+    histogram->counts[bucket_of(value)]++;
+    histogram->count++;
+    histogram->sum += value;
+    if (value < histogram->min) {
+        histogram->min = value;
+    }
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+uint64_t Histogram_percentile(const struct Histogram *histogram,
+                              double percentile) {
+    /* The number of values at or below the percentile. */
+    double wanted = percentile / 100 * (double) histogram->count;
+    uint64_t seen = 0;
+    size_t bucket;
+
+    if (histogram->count == 0) {
+        return 0;
+    }
+
+    for (bucket = 0; bucket < HISTOGRAM_BUCKET_COUNT; bucket++) {
+        seen += histogram->counts[bucket];
+        if (seen > 0 && (double) seen >= wanted) {
+            /* Within the bucket, the recorded extremes are exact. */
+            uint64_t limit = bucket_limit(bucket);
+
+            return limit < histogram->max ? limit : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+uint64_t Stats_now_ns(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+void Stats_init(struct Stats *stats) {
+    size_t i;
+
+    memset(stats, 0, sizeof *stats);
+    stats->start_ns = Stats_now_ns();
+    for (i = 0; i < STATS_HISTOGRAM_COUNT; i++) {
+        Histogram_init(&stats->histograms[i]);
+    }
+}
+
+void Stats_write(const struct Stats *stats, FILE *file) {
+    size_t i, j;
+
+    fprintf(file, "elapsed_s %.3f\n",
+            (double) (Stats_now_ns() - stats->start_ns) / 1e9);
+    fprintf(file, "frames %llu\n", (unsigned long long) stats->frame_count);
+    fprintf(file, "displayed_frames %llu\n",
+            (unsigned long long) stats->displayed_frame_count);
+    fprintf(file, "skipped_frames %llu\n",
+            (unsigned long long) stats->skipped_frame_count);
+    fprintf(file, "cycles %llu\n", (unsigned long long) stats->cycle_count);
+    fprintf(file, "key_presses %llu\n",
+            (unsigned long long) stats->key_press_count);
+    fprintf(file, "dropped_samples %llu\n",
+            (unsigned long long) stats->dropped_sample_count);
+
+    for (i = 0; i < STATS_HISTOGRAM_COUNT; i++) {
+        const struct Histogram *histogram = &stats->histograms[i];
+        double scale = HISTOGRAM_SCALES[i];
+
+        fprintf(file, "%s count %llu", HISTOGRAM_NAMES[i],
+                (unsigned long long) histogram->count);
+        if (histogram->count == 0) {
+            fprintf(file, "\n");
+            continue;
+        }
+
+        fprintf(file, " min %.1f mean %.1f",
+                (double) histogram->min / scale,
+                (double) histogram->sum / (double) histogram->count / scale);
+        for (j = 0; j < sizeof PERCENTILES / sizeof *PERCENTILES; j++) {
+            fprintf(file, " p%g %.1f", PERCENTILES[j],
+                    (double) Histogram_percentile(histogram, PERCENTILES[j])
+                    / scale);
+        }
+        fprintf(file, " max %.1f\n", (double) histogram->max / scale);
+    }
+}
+
+enum bool Stats_save(const struct Stats *stats, const char *file_name) {
+    char temporary_name[4096];
+    FILE *file;
+
+    if (snprintf(temporary_name, sizeof temporary_name, "%s.tmp",
+                 file_name) >= (int) sizeof temporary_name) {
+        return FALSE;
+    }
+
+    file = fopen(temporary_name, "w");
+    if (!file) {
+        return FALSE;
+    }
+    Stats_write(stats, file);
+    if (fclose(file) != 0) {
+        remove(temporary_name);
+        return FALSE;
+    }
+
+    return rename(temporary_name, file_name) == 0 ? TRUE : FALSE;
+}